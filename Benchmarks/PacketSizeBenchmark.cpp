@@ -0,0 +1,137 @@
+#include "QuickGameNetworking/NetSocket.h"
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/serialization/vector.hpp>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Bytes on the wire per packet. Prints the header overhead of single packets, then the
+// average datagram in both directions of a connection carrying one message per tick.
+// Each figure is shown for the legacy boost archive encoding and for the current header.
+
+namespace
+{
+    size_t constexpr MESSAGE_SIZE = 48;
+    size_t constexpr MESSAGE_COUNT = 10000;
+
+    // Packets used to go through a binary archive: enums as 4 byte ints, 64 bit sequences
+    // and the payload as a vector with a 64 bit length prefix
+    NetData LegacySerialize(NetPacket const& packet)
+    {
+        NetData buffer;
+        boost::iostreams::stream<boost::iostreams::back_insert_device<NetData>> output(buffer);
+        boost::archive::binary_oarchive archive(output, boost::archive::no_header | boost::archive::no_tracking);
+        archive << packet.m_type;
+        archive << packet.m_options;
+        archive << static_cast<uint64_t>(packet.m_ack);
+        archive << packet.m_stream;
+        archive << static_cast<uint64_t>(packet.m_streamSequence);
+        archive << packet.GetPayload();
+        output.flush();
+        return buffer;
+    }
+
+    NetData LegacyAckPacket(SequenceNumber const ack, uint32_t const window)
+    {
+        NetData buffer;
+        boost::iostreams::stream<boost::iostreams::back_insert_device<NetData>> output(buffer);
+        boost::archive::binary_oarchive archive(output, boost::archive::no_header | boost::archive::no_tracking);
+        archive << static_cast<uint64_t>(ack);
+        archive << window;
+        output.flush();
+        return buffer;
+    }
+
+    // Size the datagram would have had in the legacy encoding. Packet kinds added since are counted as they are.
+    size_t GetLegacySize(NetData const& datagram)
+    {
+        if (PacketHelpers::IsHeartbeat(datagram) || PacketHelpers::IsCompressionOffer(datagram) || PacketHelpers::IsRedundantAck(datagram)
+            || PacketHelpers::IsDeliveryReport(datagram))
+        {
+            return datagram.size();
+        }
+        if (PacketHelpers::IsAck(datagram))
+        {
+            auto const ack = PacketHelpers::GetAck(datagram);
+            return ack ? LegacyAckPacket(ack->first, ack->second).size() : datagram.size();
+        }
+        auto const packet = NetPacket::Deserialize(datagram);
+        return packet ? LegacySerialize(*packet).size() : datagram.size();
+    }
+
+    struct DatagramTotals
+    {
+        size_t m_count = 0;
+        size_t m_bytes = 0;
+        size_t m_legacyBytes = 0;
+
+        void Add(NetData const& datagram) { m_count++; m_bytes += datagram.size(); m_legacyBytes += GetLegacySize(datagram); }
+        double GetAverage() const { return m_count > 0 ? static_cast<double>(m_bytes) / m_count : 0.0; }
+        double GetLegacyAverage() const { return m_count > 0 ? static_cast<double>(m_legacyBytes) / m_count : 0.0; }
+    };
+
+    // "legacy -> current"
+    std::string FormatSizes(size_t const legacy, size_t const current)
+    {
+        return std::to_string(legacy) + " -> " + std::to_string(current);
+    }
+
+    void PrintHeaderSizes()
+    {
+        std::cout << "header bytes (payload excluded), legacy -> current\n";
+        for (size_t const payload : { 0, 32, 64, 512 })
+        {
+            NetData const data(payload);
+            NetPacket const sequenced(data, NetSendParams(ESendOptions::Sequenced), 1234, 77);
+            NetPacket const reliable(data, NetSendParams(ESendOptions::Reliable), 1234, 77);
+            NetPacket const stream(data, NetSendParams(ESendOptions::Reliable, 3), 1234, 77);
+            std::cout << "  payload " << payload
+                << ": sequenced " << FormatSizes(LegacySerialize(sequenced).size() - payload, sequenced.Serialize().size() - payload)
+                << ", reliable " << FormatSizes(LegacySerialize(reliable).size() - payload, reliable.Serialize().size() - payload)
+                << ", reliable on stream 3 " << FormatSizes(LegacySerialize(stream).size() - payload, stream.Serialize().size() - payload) << "\n";
+        }
+        std::cout << "  ack packet: " << FormatSizes(LegacyAckPacket(1234, 200).size(), PacketHelpers::GetAckPacket(1234, 200).size()) << "\n";
+    }
+
+    void PrintStreamSizes(char const* name, ESendOptions const options)
+    {
+        NetConnection sender;
+        NetConnection receiver;
+        DatagramTotals sent;
+        DatagramTotals acked;
+        for (size_t i = 0; i < MESSAGE_COUNT; ++i)
+        {
+            sender.AddSend(std::make_shared<NetData const>(MESSAGE_SIZE, static_cast<char>(i)), NetSendParams(options));
+            sender.ResetSendBudget();
+            while (auto datagram = sender.UpdateSend())
+            {
+                sent.Add(*datagram);
+                receiver.AddRecv(*datagram);
+            }
+            while (receiver.UpdateRecv())
+            {
+            }
+
+            receiver.ResetSendBudget();
+            while (auto datagram = receiver.UpdateSend())
+            {
+                acked.Add(*datagram);
+                sender.AddRecv(*datagram);
+            }
+        }
+        std::cout << std::fixed << std::setprecision(1) << "  " << name << ": " << sent.m_count << " datagrams, "
+            << sent.GetLegacyAverage() << " -> " << sent.GetAverage() << " bytes avg; " << acked.m_count << " back, "
+            << acked.GetLegacyAverage() << " -> " << acked.GetAverage() << " bytes avg\n";
+    }
+}
+
+int main()
+{
+    PrintHeaderSizes();
+    std::cout << "connection carrying " << MESSAGE_COUNT << " messages of " << MESSAGE_SIZE << " bytes\n";
+    PrintStreamSizes("sequenced", ESendOptions::Sequenced);
+    PrintStreamSizes("reliable", ESendOptions::Reliable);
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "QuickGameNetworking/NetMessagesBase.h"
+
+#include <chrono>
+#include <iostream>
+
+// Message throughput of the bit stream against the boost archive compatibility path, for the same
+// fields. Build the library optimized for meaningful numbers, the top-level project defaults to Debug.
+
+namespace
+{
+    size_t constexpr ITERATIONS = 500000;
+
+    // The fields of the demo's ObjectSyncMemento plus an id, written without quantization
+    struct BenchFields
+    {
+        uint32_t id = 17;
+        float x = 1.0f;
+        float y = 2.0f;
+        float dx = 0.01f;
+        float dy = -0.01f;
+        float scale = 0.05f;
+        float rot = 3.0f;
+
+        template<class Archive>
+        void serialize(Archive& ar, const unsigned int version)
+        {
+            ar & id;
+            ar & x;
+            ar & y;
+            ar & dx;
+            ar & dy;
+            ar & scale;
+            ar & rot;
+        }
+    };
+
+    // Fields written straight into the bit stream
+    class BitStreamMessage : public SingletonNetMessageBase, public BenchFields
+    {
+        DEFINE_NET_MESSAGE(BitStreamMessage);
+    };
+
+    // Only implements the boost functions, so the bit stream embeds a boost archive
+    class ArchiveMessage : public SingletonNetMessageBase, public BenchFields
+    {
+        DEFINE_NET_CONTAINER(ArchiveMessage);
+
+    public:
+        virtual void SerializeData(boost::archive::binary_oarchive& stream) const override { stream << static_cast<BenchFields const&>(*this); }
+        virtual void DeserializeData(boost::archive::binary_iarchive& stream) override { stream >> static_cast<BenchFields&>(*this); }
+    };
+
+    template<typename Function>
+    double GetRate(Function const& function)
+    {
+        auto const start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < ITERATIONS; ++i)
+        {
+            function();
+        }
+        std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+        return ITERATIONS / elapsed.count() / 1e6;
+    }
+
+    template<typename Message>
+    void PrintThroughput(char const* name)
+    {
+        Message message;
+        INetData const& source = message;
+        Message received;
+        INetData& target = received;
+
+        NetData buffer;
+        size_t errors = 0;
+        double const roundTrip = GetRate([&]
+        {
+            buffer.clear();
+            NetBitWriter writer(buffer);
+            source.Serialize(writer);
+            writer.Flush();
+            NetBitReader reader(buffer);
+            target.Deserialize(reader);
+            errors += reader.HasError() ? 1 : 0;
+        });
+        double const encode = GetRate([&]
+        {
+            buffer.clear();
+            NetBitWriter writer(buffer);
+            source.Serialize(writer);
+            writer.Flush();
+        });
+        double const decode = GetRate([&]
+        {
+            NetBitReader reader(buffer);
+            target.Deserialize(reader);
+            errors += reader.HasError() ? 1 : 0;
+        });
+
+        std::cout << name << ": " << buffer.size() << " bytes, round trip " << roundTrip << "M msg/s, encode "
+            << encode << "M msg/s, decode " << decode << "M msg/s";
+        if (errors > 0 || received.rot != message.rot)
+        {
+            std::cout << " (decode FAILED)";
+        }
+        std::cout << "\n";
+    }
+}
+
+int main()
+{
+    PrintThroughput<ArchiveMessage>("boost archive");
+    PrintThroughput<BitStreamMessage>("bit stream");
+    return 0;
+}
@@ -1,9 +1,5 @@
 #include "NetAPI.h"
 #include "NetMessages.h"
-#include <boost/iostreams/device/back_inserter.hpp>
-#include <boost/iostreams/stream.hpp>
-#include <boost/archive/binary_oarchive.hpp>
-#include <boost/archive/binary_iarchive.hpp>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/range/adaptor/filtered.hpp>
@@ -31,12 +27,24 @@ NetObjectAPI::NetObjectAPI(NetAddr const& hostAddress, bool const isHost)
     {
         RegisterMessageHandler<SessionSetupMessage>([this](SessionSetupMessage const& message, NetAddr const& sender)
         {
+            if (NetDataFactory::GetInstance()->SetSessionTypes(message.m_typeIDs))
+            {
+                m_typeIndexPeers.insert(sender);
+                for (auto const& connection : GetConnections())
+                {
+                    SendMessage(SessionTypesAckMessage(), connection, ESendOptions::Reliable);
+                }
+            }
             for (auto const& connection : message.m_connections)
             {
                 m_socket->Connect(connection);
             }
         });
     }
+    RegisterMessageHandler<SessionTypesAckMessage>([this](SessionTypesAckMessage const&, NetAddr const& sender)
+    {
+        m_typeIndexPeers.insert(sender);
+    });
 }
 
 void NetObjectAPI::Init(NetAddr const& hostAddress, bool const isHost)
@@ -61,7 +69,7 @@ void NetObjectAPI::Update()
         {
             std::vector<NetAddr> connections;
             boost::range::push_back(connections, GetConnections() | boost::adaptors::filtered([addr](auto const& conn) { return conn != addr; }));
-            SendMessage(SessionSetupMessage{ connections }, addr, ESendOptions::Reliable);
+            SendMessage(SessionSetupMessage{ connections, NetDataFactory::GetInstance()->GetSessionTypes() }, addr, ESendOptions::Reliable);
         }
     }
     else
@@ -70,6 +78,17 @@ void NetObjectAPI::Update()
         {
             m_socket->Connect(GetHostAddress());
         }
+        if (NetDataFactory::GetInstance()->HasSessionTypes())
+        {
+            for (auto const& addr : newConnections)
+            {
+                SendMessage(SessionTypesAckMessage(), addr, ESendOptions::Reliable);
+            }
+        }
+    }
+    for (auto const& addr : deadConnections)
+    {
+        m_typeIndexPeers.erase(addr);
     }
 
     ProcessMessages();
@@ -113,20 +132,81 @@ void NetObjectAPI::UnregisterNetObject(NetObjectDescriptor const& descriptor)
     m_netObjects[descriptor] = nullptr;
 }
 
-void NetObjectAPI::SendMessage(INetMessage const& message, NetAddr const& recipient, ESendOptions const options)
+bool NetObjectAPI::SendMessage(INetMessage const& message, NetAddr const& recipient, NetSendParams const& params)
 {
     if (recipient == m_socket->GetLocalAddress())
     {
         HandleMessage(&message, recipient);
-        return;
+        return true;
     }
-    std::vector<char> buffer;
-    boost::iostreams::stream<boost::iostreams::back_insert_device<std::vector<char>> > output_stream(buffer);
-    boost::archive::binary_oarchive stream(output_stream, boost::archive::no_header | boost::archive::no_tracking);
-    stream << message.GetTypeID();
+    bool const useTypeIndices = m_typeIndexPeers.find(recipient) != m_typeIndexPeers.end();
+    return m_socket->SendMessage(SerializeMessage(message, useTypeIndices), recipient, params);
+}
+
+bool NetObjectAPI::BroadcastMessage(INetMessage const& message, std::vector<NetAddr> const& recipients, NetSendParams const& params)
+{
+    NetAddr const localAddress = m_socket->GetLocalAddress();
+    // Serialized at most twice, for the recipients that know the session type table and those that do not yet
+    NetSharedData buffers[2];
+    bool sent = true;
+    for (NetAddr const& recipient : recipients)
+    {
+        if (recipient == localAddress)
+        {
+            HandleMessage(&message, recipient);
+            continue;
+        }
+        bool const useTypeIndices = m_typeIndexPeers.find(recipient) != m_typeIndexPeers.end();
+        NetSharedData& buffer = buffers[useTypeIndices];
+        if (!buffer)
+        {
+            buffer = SerializeMessage(message, useTypeIndices);
+        }
+        sent = m_socket->SendMessage(buffer, recipient, params) && sent;
+    }
+    return sent;
+}
+
+NetSharedData NetObjectAPI::SerializeMessage(INetMessage const& message, bool const useTypeIndices)
+{
+    std::unique_ptr<NetData> buffer = m_bufferPool.Acquire();
+    NetBitWriter stream(*buffer);
+    stream.WriteBool(useTypeIndices);
+    stream.SetUseTypeIndices(useTypeIndices);
+    stream << NetTypeID(message.GetTypeID());
     message.Serialize(stream);
-    output_stream.flush();
-    m_socket->SendMessage(buffer, recipient, options);
+    stream.Flush();
+    return m_bufferPool.Share(std::move(buffer));
+}
+
+size_t NetObjectAPI::GetSendQueueDepth(NetAddr const& recipient) const
+{
+    return m_socket->GetSendQueueDepth(recipient);
+}
+
+std::optional<NetConnectionStats> NetObjectAPI::GetConnectionStats(NetAddr const& recipient) const
+{
+    return m_socket->GetConnectionStats(recipient);
+}
+
+void NetObjectAPI::SetCongestionControllerFactory(CongestionControllerFactory const& factory)
+{
+    m_socket->SetCongestionControllerFactory(factory);
+}
+
+void NetObjectAPI::SetSendSchedulerConfig(SendSchedulerConfig const& config)
+{
+    m_socket->SetSendSchedulerConfig(config);
+}
+
+void NetObjectAPI::SetCompressionDictionary(NetData const& dictionary)
+{
+    m_socket->SetCompressionDictionary(dictionary);
+}
+
+void NetObjectAPI::SetSentPacketObserver(std::function<void(NetData const&)> const& observer)
+{
+    m_socket->SetSentPacketObserver(observer);
 }
 
 NetAddr NetObjectAPI::GetHostAddress() const
@@ -151,28 +231,39 @@ void NetObjectAPI::ProcessMessages()
 
 bool NetObjectAPI::ReceiveMessage()
 {
-    auto const msg = m_socket->RecvMessage();
+    auto msg = m_socket->RecvMessage();
     if (!msg)
     {
         return false;
     }
-    auto const&[recv_buf, addr] = msg.value();
-    boost::iostreams::basic_array_source<char> source(recv_buf.data(), recv_buf.size());
-    boost::iostreams::stream< boost::iostreams::basic_array_source <char> > input_stream(source);
-    boost::archive::binary_iarchive ia(input_stream, boost::archive::no_header | boost::archive::no_tracking);
-
-    size_t messageID;
-    ia >> messageID;
-    auto message = NetDataFactory::GetInstance()->CreateDataContainer(messageID);
+    auto&[recv_buf, addr] = msg.value();
+    ReadMessage(recv_buf, addr);
+    m_socket->RecycleBuffer(addr, std::move(recv_buf));
+    return true;
+}
+
+void NetObjectAPI::ReadMessage(NetData const& data, NetAddr const& sender)
+{
+    NetBitReader stream(data);
+    bool const useTypeIndices = stream.ReadBool();
+    if (useTypeIndices && !NetDataFactory::GetInstance()->HasSessionTypes())
+    {
+        return;
+    }
+    stream.SetUseTypeIndices(useTypeIndices);
+    auto message = NetDataFactory::GetInstance()->AcquireDataContainer(stream);
+    // a type this peer does not know, drop it and carry on with the next one
     if (!message)
     {
-        assert(false);
-        return false;
+        return;
     }
-    message->Deserialize(ia);
-
-    HandleMessage(message.get(), addr);
-    return true;
+    message->Deserialize(stream);
+    // truncated or malformed, drop it and carry on with the next one
+    if (!stream.HasError())
+    {
+        HandleMessage(message.get(), sender);
+    }
+    NetDataFactory::GetInstance()->ReleaseDataContainer(std::move(message));
 }
 
 void NetObjectAPI::HandleMessage(INetMessage const* message, NetAddr const& sender)
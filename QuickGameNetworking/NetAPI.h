@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <boost/container/flat_set.hpp>
 #include <chrono>
 #include <vector>
 #include <unordered_map>
@@ -8,6 +9,7 @@
 #ifdef _MSC_VER
 #include <xtr1common>
 #endif
+#include "NetBufferPool.h"
 #include "NetSocket.h"
 #include "NetMessagesBase.h"
 #include "NetObject.h"
@@ -26,7 +28,16 @@ public:
     std::unique_ptr<NetObject> CreateReplicaNetObject(NetObjectDescriptor const& descriptor);
     std::unique_ptr<NetObject> CreateThirdPartyNetObject(NetObjectDescriptor const& descriptor);
 
-    void SendMessage(INetMessage const& message, NetAddr const& recipient, ESendOptions const options = ESendOptions::None);
+    // Returns false when the recipient's send queue is full; the caller should back off and retry later
+    bool SendMessage(INetMessage const& message, NetAddr const& recipient, NetSendParams const& params = {});
+    // Serializes the message once and queues the same buffer for every recipient, false if any queue was full
+    bool BroadcastMessage(INetMessage const& message, std::vector<NetAddr> const& recipients, NetSendParams const& params = {});
+    size_t GetSendQueueDepth(NetAddr const& recipient) const;
+    std::optional<NetConnectionStats> GetConnectionStats(NetAddr const& recipient) const;
+    void SetCongestionControllerFactory(CongestionControllerFactory const& factory);
+    void SetSendSchedulerConfig(SendSchedulerConfig const& config);
+    void SetCompressionDictionary(NetData const& dictionary);
+    void SetSentPacketObserver(std::function<void(NetData const&)> const& observer);
 
     NetAddr GetHostAddress() const;
     NetAddr GetLocalAddress() const;
@@ -42,8 +53,10 @@ private:
     NetObjectAPI(NetAddr const& hostAddress, bool const isHost);
     NetObjectAPI(NetObjectAPI const& other) = delete;
 
+    NetSharedData SerializeMessage(INetMessage const& message, bool const useTypeIndices);
     void ProcessMessages();
     bool ReceiveMessage();
+    void ReadMessage(NetData const& data, NetAddr const& sender);
     void HandleMessage(INetMessage const* message, NetAddr const& sender);
 
 private:
@@ -51,6 +64,9 @@ private:
     NetObjectMap m_netObjects;
     std::unordered_map <size_t, std::function<std::unique_ptr<INetMessage>()>> m_messageFactory;
     std::optional<NetSocket> m_socket;
+    NetBufferPool m_bufferPool;
+    // Peers known to have the session type table
+    boost::container::flat_set<NetAddr> m_typeIndexPeers;
     NetAddr m_hostAddress;
     bool const m_isHost;
 
@@ -0,0 +1,185 @@
+#include "NetBitStream.h"
+#include <cassert>
+#include <cstring>
+
+void NetBitWriter::WriteBits(uint32_t const value, uint32_t const bits)
+{
+    assert(bits <= 32);
+    uint64_t const mask = (uint64_t(1) << bits) - 1;
+    m_scratch |= (value & mask) << m_scratchBits;
+    m_scratchBits += bits;
+    while (m_scratchBits >= 8)
+    {
+        m_buffer.push_back(static_cast<char>(m_scratch & 0xff));
+        m_scratch >>= 8;
+        m_scratchBits -= 8;
+    }
+}
+
+void NetBitWriter::WriteUInt64(uint64_t const value)
+{
+    WriteBits(static_cast<uint32_t>(value), 32);
+    WriteBits(static_cast<uint32_t>(value >> 32), 32);
+}
+
+void NetBitWriter::WriteVarUInt(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        WriteBits(static_cast<uint32_t>(value & 0x7f) | 0x80, 8);
+        value >>= 7;
+    }
+    WriteBits(static_cast<uint32_t>(value), 8);
+}
+
+void NetBitWriter::WriteFloat(float const value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    WriteBits(bits, 32);
+}
+
+void NetBitWriter::WriteDouble(double const value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    WriteUInt64(bits);
+}
+
+void NetBitWriter::WriteBytes(char const* data, size_t const size)
+{
+    if (m_scratchBits == 0)
+    {
+        m_buffer.insert(m_buffer.end(), data, data + size);
+        return;
+    }
+    for (size_t i = 0; i < size; ++i)
+    {
+        WriteBits(static_cast<uint8_t>(data[i]), 8);
+    }
+}
+
+void NetBitWriter::Flush()
+{
+    if (m_scratchBits > 0)
+    {
+        m_buffer.push_back(static_cast<char>(m_scratch & 0xff));
+        m_scratch = 0;
+        m_scratchBits = 0;
+    }
+}
+
+uint32_t NetBitReader::ReadBits(uint32_t const bits)
+{
+    assert(bits <= 32);
+    if (m_error || bits > GetRemainingBits())
+    {
+        m_error = true;
+        return 0;
+    }
+    while (m_scratchBits < bits)
+    {
+        m_scratch |= uint64_t(static_cast<uint8_t>(m_data[m_offset++])) << m_scratchBits;
+        m_scratchBits += 8;
+    }
+    uint64_t const mask = (uint64_t(1) << bits) - 1;
+    uint32_t const value = static_cast<uint32_t>(m_scratch & mask);
+    m_scratch >>= bits;
+    m_scratchBits -= bits;
+    return value;
+}
+
+uint64_t NetBitReader::ReadUInt64()
+{
+    uint64_t const low = ReadBits(32);
+    uint64_t const high = ReadBits(32);
+    return low | (high << 32);
+}
+
+uint64_t NetBitReader::ReadVarUInt()
+{
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+        uint32_t const byte = ReadBits(8);
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return value;
+        }
+    }
+    m_error = true;
+    return 0;
+}
+
+float NetBitReader::ReadFloat()
+{
+    uint32_t const bits = ReadBits(32);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+double NetBitReader::ReadDouble()
+{
+    uint64_t const bits = ReadUInt64();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool NetBitReader::ReadBytes(char* data, size_t const size)
+{
+    if (m_error || size > GetRemainingBits() / 8)
+    {
+        m_error = true;
+        return false;
+    }
+    if (m_scratchBits == 0)
+    {
+        std::memcpy(data, m_data + m_offset, size);
+        m_offset += size;
+        return true;
+    }
+    for (size_t i = 0; i < size; ++i)
+    {
+        data[i] = static_cast<char>(ReadBits(8));
+    }
+    return true;
+}
+
+void NetSerialize(NetBitWriter& stream, std::string const& value)
+{
+    stream.WriteVarUInt(value.size());
+    stream.WriteBytes(value.data(), value.size());
+}
+
+void NetDeserialize(NetBitReader& stream, std::string& value)
+{
+    uint64_t const size = stream.ReadVarUInt();
+    if (size > stream.GetRemainingBits() / 8)
+    {
+        stream.SetError();
+        return;
+    }
+    value.resize(static_cast<size_t>(size));
+    stream.ReadBytes(&value[0], value.size());
+}
+
+void NetSerialize(NetBitWriter& stream, NetData const& value)
+{
+    stream.WriteVarUInt(value.size());
+    stream.WriteBytes(value.data(), value.size());
+}
+
+void NetDeserialize(NetBitReader& stream, NetData& value)
+{
+    uint64_t const size = stream.ReadVarUInt();
+    if (size > stream.GetRemainingBits() / 8)
+    {
+        stream.SetError();
+        return;
+    }
+    value.resize(static_cast<size_t>(size));
+    stream.ReadBytes(value.data(), value.size());
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using NetData = std::vector<char>;
+// Serialized message shared by the send queues of every recipient it was broadcast to
+using NetSharedData = std::shared_ptr<NetData const>;
+
+// Packs values LSB first into a byte buffer with no per-value framing.
+// Call Flush once done to write out the last partial byte.
+class NetBitWriter
+{
+public:
+    NetBitWriter(NetData& buffer) : m_buffer(buffer) {}
+
+    void WriteBits(uint32_t const value, uint32_t const bits);
+    void WriteBool(bool const value) { WriteBits(value ? 1 : 0, 1); }
+    void WriteUInt64(uint64_t const value);
+    void WriteVarUInt(uint64_t value);
+    void WriteVarInt(int64_t const value) { WriteVarUInt((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)); }
+    void WriteFloat(float const value);
+    void WriteDouble(double const value);
+    void WriteBytes(char const* data, size_t const size);
+    void Flush();
+
+    // Set when the receiver knows the session type table, type IDs then go out as indices into it
+    void SetUseTypeIndices(bool const useTypeIndices) { m_useTypeIndices = useTypeIndices; }
+    bool UsesTypeIndices() const { return m_useTypeIndices; }
+
+    // Boost archive style operators so existing serialize templates can target the bit stream
+    template<typename T> NetBitWriter& operator<<(T const& value) { NetSerialize(*this, value); return *this; }
+    template<typename T> NetBitWriter& operator&(T const& value) { return *this << value; }
+
+private:
+    NetData& m_buffer;
+    uint64_t m_scratch = 0;
+    uint32_t m_scratchBits = 0;
+    bool m_useTypeIndices = false;
+};
+
+// Reads back what NetBitWriter wrote. Reading past the end or hitting malformed data
+// sets a sticky error flag and yields zeroes, so callers check HasError once at the end.
+class NetBitReader
+{
+public:
+    NetBitReader(char const* data, size_t const size) : m_data(data), m_size(size) {}
+    NetBitReader(NetData const& data) : NetBitReader(data.data(), data.size()) {}
+
+    uint32_t ReadBits(uint32_t const bits);
+    bool ReadBool() { return ReadBits(1) != 0; }
+    uint64_t ReadUInt64();
+    uint64_t ReadVarUInt();
+    int64_t ReadVarInt() { uint64_t const value = ReadVarUInt(); return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+    float ReadFloat();
+    double ReadDouble();
+    bool ReadBytes(char* data, size_t const size);
+
+    size_t GetRemainingBits() const { return (m_size - m_offset) * 8 + m_scratchBits; }
+    bool HasError() const { return m_error; }
+    void SetError() { m_error = true; }
+
+    void SetUseTypeIndices(bool const useTypeIndices) { m_useTypeIndices = useTypeIndices; }
+    bool UsesTypeIndices() const { return m_useTypeIndices; }
+
+    template<typename T> NetBitReader& operator>>(T& value) { NetDeserialize(*this, value); return *this; }
+    template<typename T> NetBitReader& operator&(T& value) { return *this >> value; }
+
+private:
+    char const* m_data;
+    size_t m_size;
+    size_t m_offset = 0;
+    uint64_t m_scratch = 0;
+    uint32_t m_scratchBits = 0;
+    bool m_error = false;
+    bool m_useTypeIndices = false;
+};
+
+// Varints take at most this many bits for a 64 bit value
+size_t constexpr MAX_VARINT_BITS = 80;
+
+// 64 bit integers mostly hold ids and counts far below their range, so they go out as varints
+// (zigzag for signed ones); narrower integers keep their fixed width
+template<typename T>
+std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>> NetSerialize(NetBitWriter& stream, T const& value)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        stream.WriteBool(value);
+    }
+    else if constexpr (sizeof(T) <= sizeof(uint32_t))
+    {
+        stream.WriteBits(static_cast<uint32_t>(value), 8 * sizeof(T));
+    }
+    else if constexpr (std::is_signed_v<T>)
+    {
+        stream.WriteVarInt(static_cast<int64_t>(value));
+    }
+    else
+    {
+        stream.WriteVarUInt(static_cast<uint64_t>(value));
+    }
+}
+
+template<typename T>
+std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>> NetDeserialize(NetBitReader& stream, T& value)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        value = stream.ReadBool();
+    }
+    else if constexpr (sizeof(T) <= sizeof(uint32_t))
+    {
+        value = static_cast<T>(stream.ReadBits(8 * sizeof(T)));
+    }
+    else if constexpr (std::is_signed_v<T>)
+    {
+        value = static_cast<T>(stream.ReadVarInt());
+    }
+    else
+    {
+        value = static_cast<T>(stream.ReadVarUInt());
+    }
+}
+
+inline void NetSerialize(NetBitWriter& stream, float const value) { stream.WriteFloat(value); }
+inline void NetDeserialize(NetBitReader& stream, float& value) { value = stream.ReadFloat(); }
+inline void NetSerialize(NetBitWriter& stream, double const value) { stream.WriteDouble(value); }
+inline void NetDeserialize(NetBitReader& stream, double& value) { value = stream.ReadDouble(); }
+
+void NetSerialize(NetBitWriter& stream, std::string const& value);
+void NetDeserialize(NetBitReader& stream, std::string& value);
+void NetSerialize(NetBitWriter& stream, NetData const& value);
+void NetDeserialize(NetBitReader& stream, NetData& value);
+
+template<typename T>
+void NetSerialize(NetBitWriter& stream, std::vector<T> const& value)
+{
+    stream.WriteVarUInt(value.size());
+    for (T const& element : value)
+    {
+        stream << element;
+    }
+}
+
+template<typename T>
+void NetDeserialize(NetBitReader& stream, std::vector<T>& value)
+{
+    uint64_t const size = stream.ReadVarUInt();
+    // every element takes at least one bit, anything longer is malformed
+    if (size > stream.GetRemainingBits())
+    {
+        stream.SetError();
+        return;
+    }
+    value.resize(static_cast<size_t>(size));
+    for (T& element : value)
+    {
+        stream >> element;
+    }
+}
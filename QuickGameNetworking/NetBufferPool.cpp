@@ -0,0 +1,98 @@
+#include "NetBufferPool.h"
+
+// Larger buffers are freed rather than kept around for the next small message
+size_t constexpr MAX_POOLED_BUFFER_CAPACITY = 4096;
+size_t constexpr MAX_POOLED_BUFFERS = 1024;
+
+struct NetBufferPool::State
+{
+    // Deleter of shared buffers, hands them back to the pool
+    struct Recycler
+    {
+        void operator()(NetData const* buffer) const
+        {
+            std::unique_ptr<NetData> owned(const_cast<NetData*>(buffer));
+            if (owned->capacity() <= MAX_POOLED_BUFFER_CAPACITY && m_state->m_freeBuffers.size() < MAX_POOLED_BUFFERS)
+            {
+                owned->clear();
+                m_state->m_freeBuffers.push_back(std::move(owned));
+            }
+        }
+
+        std::shared_ptr<State> m_state;
+    };
+
+    // Allocates the shared_ptr control blocks, which all have the size of the first one
+    template<typename T>
+    struct BlockAllocator
+    {
+        using value_type = T;
+
+        BlockAllocator(std::shared_ptr<State> const& state) : m_state(state) {}
+        template<typename U> BlockAllocator(BlockAllocator<U> const& other) : m_state(other.m_state) {}
+
+        T* allocate(size_t const count)
+        {
+            size_t const size = count * sizeof(T);
+            if (m_state->m_blockSize == 0)
+            {
+                m_state->m_blockSize = size;
+            }
+            if (size == m_state->m_blockSize && !m_state->m_freeBlocks.empty())
+            {
+                void* const block = m_state->m_freeBlocks.back();
+                m_state->m_freeBlocks.pop_back();
+                return static_cast<T*>(block);
+            }
+            return static_cast<T*>(::operator new(size));
+        }
+
+        void deallocate(T* const block, size_t const count)
+        {
+            if (count * sizeof(T) == m_state->m_blockSize && m_state->m_freeBlocks.size() < MAX_POOLED_BUFFERS)
+            {
+                m_state->m_freeBlocks.push_back(block);
+                return;
+            }
+            ::operator delete(block);
+        }
+
+        template<typename U> bool operator==(BlockAllocator<U> const& other) const { return m_state == other.m_state; }
+        template<typename U> bool operator!=(BlockAllocator<U> const& other) const { return m_state != other.m_state; }
+
+        std::shared_ptr<State> m_state;
+    };
+
+    ~State()
+    {
+        for (void* block : m_freeBlocks)
+        {
+            ::operator delete(block);
+        }
+    }
+
+    std::vector<std::unique_ptr<NetData>> m_freeBuffers;
+    std::vector<void*> m_freeBlocks;
+    size_t m_blockSize = 0;
+};
+
+NetBufferPool::NetBufferPool()
+    : m_state(std::make_shared<State>())
+{
+}
+
+std::unique_ptr<NetData> NetBufferPool::Acquire()
+{
+    if (m_state->m_freeBuffers.empty())
+    {
+        return std::make_unique<NetData>();
+    }
+    std::unique_ptr<NetData> buffer = std::move(m_state->m_freeBuffers.back());
+    m_state->m_freeBuffers.pop_back();
+    return buffer;
+}
+
+NetSharedData NetBufferPool::Share(std::unique_ptr<NetData>&& buffer)
+{
+    return NetSharedData(buffer.release(), State::Recycler{ m_state }, State::BlockAllocator<char>(m_state));
+}
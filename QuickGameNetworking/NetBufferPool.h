@@ -0,0 +1,23 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "NetBitStream.h"
+
+// Recycles message buffers along with the shared_ptr control blocks that own them, so a steady
+// flow of messages keeps reusing the same memory. Not thread safe, each thread needs its own pool.
+// Shared buffers may safely outlive the pool.
+class NetBufferPool
+{
+public:
+    NetBufferPool();
+
+    // Empty buffer keeping the capacity of an earlier message
+    std::unique_ptr<NetData> Acquire();
+    // Hands the buffer out read-only, it comes back to the pool once the last reference is gone
+    NetSharedData Share(std::unique_ptr<NetData>&& buffer);
+
+private:
+    struct State;
+
+    std::shared_ptr<State> m_state;
+};
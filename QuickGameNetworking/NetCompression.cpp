@@ -0,0 +1,244 @@
+#include "NetCompression.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <zlib.h>
+
+// 4 KB window: the dictionary plus the largest datagram, with the 262 bytes deflate keeps in reserve
+int constexpr COMPRESSION_WINDOW_BITS = 12;
+// 4096 hash buckets, as many as the window has positions; larger tables only make restoring the stream slower
+int constexpr COMPRESSION_MEM_LEVEL = 5;
+size_t constexpr DICTIONARY_GRAM_SIZE = 6;
+size_t constexpr MAX_DICTIONARY_SEGMENT = 64;
+
+namespace
+{
+    uint32_t HashDictionary(NetData const& dictionary)
+    {
+        uint32_t hash = 2166136261u;
+        for (char const byte : dictionary)
+        {
+            hash = (hash ^ static_cast<uint8_t>(byte)) * 16777619u;
+        }
+        return hash != 0 ? hash : 1;
+    }
+
+    size_t GetCount(std::unordered_map<std::string, size_t> const& counts, std::string const& gram)
+    {
+        auto const it = counts.find(gram);
+        return it != counts.end() ? it->second : 0;
+    }
+
+    // Keeps the blocks zlib frees for its next allocation of the same size. Restoring the primed
+    // stream for every datagram allocates the same few buffers each time, so they stay off the heap.
+    struct ZlibBlockPool
+    {
+        struct Block
+        {
+            void* m_data;
+            size_t m_size;
+            bool m_used;
+        };
+
+        ~ZlibBlockPool()
+        {
+            for (Block const& block : m_blocks)
+            {
+                std::free(block.m_data);
+            }
+        }
+
+        std::vector<Block> m_blocks;
+    };
+
+    voidpf AllocateZlibBlock(voidpf opaque, uInt items, uInt size)
+    {
+        ZlibBlockPool& pool = *static_cast<ZlibBlockPool*>(opaque);
+        size_t const bytes = static_cast<size_t>(items) * size;
+        auto it = std::find_if(pool.m_blocks.begin(), pool.m_blocks.end(), [bytes](auto const& block) { return !block.m_used && block.m_size == bytes; });
+        if (it == pool.m_blocks.end())
+        {
+            void* const data = std::malloc(bytes);
+            if (!data)
+            {
+                return Z_NULL;
+            }
+            it = pool.m_blocks.insert(pool.m_blocks.end(), ZlibBlockPool::Block{ data, bytes, false });
+        }
+        it->m_used = true;
+        return it->m_data;
+    }
+
+    void FreeZlibBlock(voidpf opaque, voidpf address)
+    {
+        ZlibBlockPool& pool = *static_cast<ZlibBlockPool*>(opaque);
+        auto const it = std::find_if(pool.m_blocks.begin(), pool.m_blocks.end(), [address](auto const& block) { return block.m_data == address; });
+        assert(it != pool.m_blocks.end());
+        it->m_used = false;
+    }
+}
+
+NetData TrainCompressionDictionary(std::vector<NetData> const& samples, size_t const maxSize)
+{
+    std::unordered_map<std::string, size_t> counts;
+    for (NetData const& sample : samples)
+    {
+        for (size_t i = 0; i + DICTIONARY_GRAM_SIZE <= sample.size(); ++i)
+        {
+            counts[std::string(sample.data() + i, DICTIONARY_GRAM_SIZE)]++;
+        }
+    }
+
+    std::vector<std::pair<std::string, size_t>> grams(counts.begin(), counts.end());
+    std::sort(grams.begin(), grams.end(), [](auto const& lhs, auto const& rhs) { return lhs.second != rhs.second ? lhs.second > rhs.second : lhs.first < rhs.first; });
+
+    // Grow each frequent gram into a segment while some continuation is at least half as frequent,
+    // then retire every gram inside it so overlapping grams do not fill the dictionary with copies
+    std::vector<std::string> segments;
+    size_t size = 0;
+    for (auto const& [seed, seedCount] : grams)
+    {
+        if (seedCount < 2 || size + DICTIONARY_GRAM_SIZE > maxSize)
+        {
+            break;
+        }
+        if (GetCount(counts, seed) == 0)
+        {
+            continue;
+        }
+
+        std::string segment = seed;
+        auto extend = [&](bool const right)
+        {
+            while (segment.size() < MAX_DICTIONARY_SEGMENT && size + segment.size() < maxSize)
+            {
+                std::string const overlap = right ? segment.substr(segment.size() - DICTIONARY_GRAM_SIZE + 1) : segment.substr(0, DICTIONARY_GRAM_SIZE - 1);
+                size_t bestCount = 0;
+                char bestByte = 0;
+                for (int byte = 0; byte < 256; ++byte)
+                {
+                    std::string const gram = right ? overlap + static_cast<char>(byte) : static_cast<char>(byte) + overlap;
+                    size_t const count = GetCount(counts, gram);
+                    if (count > bestCount)
+                    {
+                        bestCount = count;
+                        bestByte = static_cast<char>(byte);
+                    }
+                }
+                if (bestCount * 2 < seedCount)
+                {
+                    return;
+                }
+                segment = right ? segment + bestByte : bestByte + segment;
+            }
+        };
+        extend(true);
+        extend(false);
+
+        for (size_t i = 0; i + DICTIONARY_GRAM_SIZE <= segment.size(); ++i)
+        {
+            counts[segment.substr(i, DICTIONARY_GRAM_SIZE)] = 0;
+        }
+        size += segment.size();
+        segments.push_back(std::move(segment));
+    }
+
+    NetData dictionary;
+    dictionary.reserve(size);
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it)
+    {
+        dictionary.insert(dictionary.end(), it->begin(), it->end());
+    }
+    return dictionary;
+}
+
+struct NetPacketCompressor::Streams
+{
+    ZlibBlockPool m_pool;
+    // Holds the dictionary and never compresses, each datagram starts from a copy of it
+    z_stream m_primedDeflate = {};
+    z_stream m_deflate = {};
+    z_stream m_inflate = {};
+};
+
+NetPacketCompressor::NetPacketCompressor(NetData const& dictionary)
+    : m_dictionary(dictionary.size() > MAX_COMPRESSION_DICTIONARY_SIZE ? NetData(dictionary.end() - MAX_COMPRESSION_DICTIONARY_SIZE, dictionary.end()) : dictionary)
+    , m_dictionaryId(HashDictionary(m_dictionary))
+    , m_streams(std::make_unique<Streams>())
+{
+    z_stream& primed = m_streams->m_primedDeflate;
+    primed.zalloc = AllocateZlibBlock;
+    primed.zfree = FreeZlibBlock;
+    primed.opaque = &m_streams->m_pool;
+    int const deflateResult = deflateInit2(&primed, Z_BEST_COMPRESSION, Z_DEFLATED, -COMPRESSION_WINDOW_BITS, COMPRESSION_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    if (deflateResult == Z_OK && !m_dictionary.empty())
+    {
+        deflateSetDictionary(&primed, reinterpret_cast<Bytef const*>(m_dictionary.data()), static_cast<uInt>(m_dictionary.size()));
+    }
+    int const copyResult = deflateCopy(&m_streams->m_deflate, &primed);
+    int const inflateResult = inflateInit2(&m_streams->m_inflate, -COMPRESSION_WINDOW_BITS);
+    assert(deflateResult == Z_OK && copyResult == Z_OK && inflateResult == Z_OK);
+}
+
+NetPacketCompressor::~NetPacketCompressor()
+{
+    deflateEnd(&m_streams->m_deflate);
+    deflateEnd(&m_streams->m_primedDeflate);
+    inflateEnd(&m_streams->m_inflate);
+}
+
+bool NetPacketCompressor::Compress(char const* data, size_t const size, NetData& out)
+{
+    if (size < 2)
+    {
+        return false;
+    }
+    // copying the primed state is cheaper than hashing the whole dictionary in again
+    z_stream& stream = m_streams->m_deflate;
+    deflateEnd(&stream);
+    if (deflateCopy(&stream, &m_streams->m_primedDeflate) != Z_OK)
+    {
+        return false;
+    }
+
+    // one byte less than the input, so running out of room means it did not shrink
+    size_t const offset = out.size();
+    out.resize(offset + size - 1);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+    stream.avail_out = static_cast<uInt>(size - 1);
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+    {
+        out.resize(offset);
+        return false;
+    }
+    out.resize(offset + size - 1 - stream.avail_out);
+    return true;
+}
+
+bool NetPacketCompressor::Decompress(char const* data, size_t const size, NetData& out, size_t const maxSize)
+{
+    z_stream& stream = m_streams->m_inflate;
+    inflateReset(&stream);
+    if (!m_dictionary.empty())
+    {
+        inflateSetDictionary(&stream, reinterpret_cast<Bytef const*>(m_dictionary.data()), static_cast<uInt>(m_dictionary.size()));
+    }
+
+    size_t const offset = out.size();
+    out.resize(offset + maxSize);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+    stream.avail_out = static_cast<uInt>(maxSize);
+    if (inflate(&stream, Z_FINISH) != Z_STREAM_END || stream.avail_in != 0)
+    {
+        out.resize(offset);
+        return false;
+    }
+    out.resize(offset + maxSize - stream.avail_out);
+    return true;
+}
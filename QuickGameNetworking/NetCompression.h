@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "NetBitStream.h"
+
+// Deflate looks back at most this far, so larger dictionaries would be partly unused
+size_t constexpr MAX_COMPRESSION_DICTIONARY_SIZE = 2048;
+
+// Builds a preset dictionary from captured datagrams: the byte sequences repeated most often
+// across the samples, with the most frequent ones last where deflate reaches them cheapest.
+NetData TrainCompressionDictionary(std::vector<NetData> const& samples, size_t const maxSize = MAX_COMPRESSION_DICTIONARY_SIZE);
+
+// Raw deflate with a preset dictionary, restarted for every datagram so each one decodes on its own.
+// The compressor restores a stream primed with the dictionary rather than setting it up each time.
+// Both peers must use the same dictionary, GetDictionaryId tells them apart.
+class NetPacketCompressor
+{
+public:
+    NetPacketCompressor(NetData const& dictionary);
+    ~NetPacketCompressor();
+    NetPacketCompressor(NetPacketCompressor const& other) = delete;
+
+    // Never 0, which peers without a dictionary advertise
+    uint32_t GetDictionaryId() const { return m_dictionaryId; }
+
+    // Appends the compressed bytes to out, false when they would not be smaller than size
+    bool Compress(char const* data, size_t const size, NetData& out);
+    // Appends the decompressed bytes to out, false for corrupt input or output above maxSize
+    bool Decompress(char const* data, size_t const size, NetData& out, size_t const maxSize);
+
+private:
+    struct Streams;
+
+    NetData m_dictionary;
+    uint32_t m_dictionaryId;
+    std::unique_ptr<Streams> m_streams;
+};
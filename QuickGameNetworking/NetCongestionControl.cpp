@@ -0,0 +1,127 @@
+#include "NetCongestionControl.h"
+#include <algorithm>
+
+size_t constexpr MAX_SEGMENT_SIZE = 1024;
+size_t constexpr INITIAL_CONGESTION_WINDOW = 16 * MAX_SEGMENT_SIZE;
+size_t constexpr MIN_CONGESTION_WINDOW = 2 * MAX_SEGMENT_SIZE;
+size_t constexpr MAX_CONGESTION_WINDOW = 256 * MAX_SEGMENT_SIZE;
+size_t constexpr INITIAL_RTT = 200;
+size_t constexpr TARGET_QUEUING_DELAY = 25;
+double constexpr DELAY_GAIN = 1.0;
+
+namespace
+{
+    double ClampWindow(double const window)
+    {
+        return std::clamp<double>(window, MIN_CONGESTION_WINDOW, MAX_CONGESTION_WINDOW);
+    }
+
+    // Reacting to every lost packet of a single burst would collapse the window, so back off at most once per round trip
+    bool TryStartDecrease(std::chrono::system_clock::time_point& lastDecreaseTime, std::chrono::milliseconds const rtt)
+    {
+        auto const now = std::chrono::system_clock::now();
+        if (now - lastDecreaseTime < rtt)
+        {
+            return false;
+        }
+        lastDecreaseTime = now;
+        return true;
+    }
+
+    // A tick is window-limited when it left no room for another full datagram in its budget
+    void EndTick(size_t& tickBytesSent, double const window, std::chrono::system_clock::time_point& lastWindowLimitedTime)
+    {
+        if (tickBytesSent + MAX_SEGMENT_SIZE > window)
+        {
+            lastWindowLimitedTime = std::chrono::system_clock::now();
+        }
+        tickBytesSent = 0;
+    }
+
+    // An application-limited sender never tests a larger window, so it must not grow it either.
+    // Acks come in a round trip after their data went out, so allow for that much delay plus slack.
+    bool WasWindowLimited(std::chrono::system_clock::time_point const lastWindowLimitedTime, std::chrono::milliseconds const rtt)
+    {
+        return std::chrono::system_clock::now() - lastWindowLimitedTime <= 2 * rtt;
+    }
+}
+
+AimdCongestionController::AimdCongestionController()
+    : m_window(INITIAL_CONGESTION_WINDOW)
+    , m_slowStartThreshold(MAX_CONGESTION_WINDOW)
+    , m_lastRtt(INITIAL_RTT)
+{
+}
+
+void AimdCongestionController::OnPacketAcked(size_t const bytes, std::optional<std::chrono::milliseconds> const rtt)
+{
+    if (rtt)
+    {
+        m_lastRtt = *rtt;
+    }
+    if (!WasWindowLimited(m_lastWindowLimitedTime, m_lastRtt))
+    {
+        return;
+    }
+    if (m_window < m_slowStartThreshold)
+    {
+        m_window += bytes;
+    }
+    else
+    {
+        m_window += static_cast<double>(MAX_SEGMENT_SIZE) * bytes / m_window;
+    }
+    m_window = ClampWindow(m_window);
+}
+
+void AimdCongestionController::OnPacketLost(size_t const)
+{
+    if (TryStartDecrease(m_lastDecreaseTime, m_lastRtt))
+    {
+        m_slowStartThreshold = ClampWindow(m_window / 2);
+        m_window = m_slowStartThreshold;
+    }
+}
+
+void AimdCongestionController::OnSendTick()
+{
+    EndTick(m_tickBytesSent, m_window, m_lastWindowLimitedTime);
+}
+
+DelayCongestionController::DelayCongestionController()
+    : m_window(INITIAL_CONGESTION_WINDOW)
+    , m_lastRtt(INITIAL_RTT)
+{
+}
+
+void DelayCongestionController::OnPacketAcked(size_t const bytes, std::optional<std::chrono::milliseconds> const rtt)
+{
+    if (!rtt)
+    {
+        return;
+    }
+    m_lastRtt = *rtt;
+    m_baseRtt = m_baseRtt ? std::min(*m_baseRtt, *rtt) : *rtt;
+
+    double const queuingDelay = static_cast<double>((*rtt - *m_baseRtt).count());
+    double const offTarget = std::max((TARGET_QUEUING_DELAY - queuingDelay) / TARGET_QUEUING_DELAY, -1.0);
+    // growing needs proof the window is used, backing off on delay never does
+    if (offTarget > 0 && !WasWindowLimited(m_lastWindowLimitedTime, m_lastRtt))
+    {
+        return;
+    }
+    m_window = ClampWindow(m_window + DELAY_GAIN * offTarget * MAX_SEGMENT_SIZE * bytes / m_window);
+}
+
+void DelayCongestionController::OnPacketLost(size_t const)
+{
+    if (TryStartDecrease(m_lastDecreaseTime, m_lastRtt))
+    {
+        m_window = ClampWindow(m_window / 2);
+    }
+}
+
+void DelayCongestionController::OnSendTick()
+{
+    EndTick(m_tickBytesSent, m_window, m_lastWindowLimitedTime);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+
+// Decides how many bytes a connection may put on the wire per update tick.
+// Told about every datagram sent and, for data of all channels, which bytes the peer received or lost.
+class ICongestionController
+{
+public:
+    virtual ~ICongestionController() = default;
+
+    virtual void OnPacketSent(size_t const bytes) = 0;
+    // rtt is empty for retransmitted packets since their sample is ambiguous, and for unreliable data
+    virtual void OnPacketAcked(size_t const bytes, std::optional<std::chrono::milliseconds> const rtt) = 0;
+    virtual void OnPacketLost(size_t const bytes) = 0;
+    // A new update tick starts, the bytes sent since the last call made up the previous one
+    virtual void OnSendTick() = 0;
+
+    virtual size_t GetCongestionWindow() const = 0;
+};
+
+using CongestionControllerFactory = std::function<std::unique_ptr<ICongestionController>()>;
+
+// Loss-based additive increase / multiplicative decrease with slow start
+class AimdCongestionController : public ICongestionController
+{
+public:
+    AimdCongestionController();
+
+    virtual void OnPacketSent(size_t const bytes) override { m_tickBytesSent += bytes; }
+    virtual void OnPacketAcked(size_t const bytes, std::optional<std::chrono::milliseconds> const rtt) override;
+    virtual void OnPacketLost(size_t const bytes) override;
+    virtual void OnSendTick() override;
+
+    virtual size_t GetCongestionWindow() const override { return static_cast<size_t>(m_window); }
+
+private:
+    double m_window;
+    size_t m_tickBytesSent = 0;
+    double m_slowStartThreshold;
+    std::chrono::milliseconds m_lastRtt;
+    std::chrono::system_clock::time_point m_lastDecreaseTime;
+    std::chrono::system_clock::time_point m_lastWindowLimitedTime;
+};
+
+// Delay-based controller in the spirit of LEDBAT: grows while queuing delay
+// stays under target and backs off as soon as the link starts buffering
+class DelayCongestionController : public ICongestionController
+{
+public:
+    DelayCongestionController();
+
+    virtual void OnPacketSent(size_t const bytes) override { m_tickBytesSent += bytes; }
+    virtual void OnPacketAcked(size_t const bytes, std::optional<std::chrono::milliseconds> const rtt) override;
+    virtual void OnPacketLost(size_t const bytes) override;
+    virtual void OnSendTick() override;
+
+    virtual size_t GetCongestionWindow() const override { return static_cast<size_t>(m_window); }
+
+private:
+    double m_window;
+    size_t m_tickBytesSent = 0;
+    std::optional<std::chrono::milliseconds> m_baseRtt;
+    std::chrono::milliseconds m_lastRtt;
+    std::chrono::system_clock::time_point m_lastDecreaseTime;
+    std::chrono::system_clock::time_point m_lastWindowLimitedTime;
+};
@@ -2,9 +2,88 @@
 #include "NetMessagesBase.h"
 #include "NetMessages.h"
 #include "NetObjectDescriptor.h"
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/archive/archive_exception.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+// Enough for a burst of one message type handled while more of the same are being received
+size_t constexpr MAX_FREE_CONTAINERS_PER_TYPE = 8;
 
 std::unique_ptr<NetDataFactory> NetDataFactory::ms_instance;
 
+void SerializeWithArchive(NetBitWriter& stream, std::function<void(boost::archive::binary_oarchive&)> const& save)
+{
+    // Reused across calls, the archive only ever appends to it
+    thread_local NetData buffer;
+    buffer.clear();
+    {
+        boost::iostreams::stream<boost::iostreams::back_insert_device<NetData>> output_stream(buffer);
+        boost::archive::binary_oarchive archive(output_stream, boost::archive::no_header | boost::archive::no_tracking);
+        save(archive);
+    }
+    stream.WriteVarUInt(buffer.size());
+    stream.WriteBytes(buffer.data(), buffer.size());
+}
+
+void DeserializeWithArchive(NetBitReader& stream, std::function<void(boost::archive::binary_iarchive&)> const& load)
+{
+    uint64_t const size = stream.ReadVarUInt();
+    if (size > stream.GetRemainingBits() / 8)
+    {
+        stream.SetError();
+        return;
+    }
+    thread_local NetData buffer;
+    buffer.resize(static_cast<size_t>(size));
+    stream.ReadBytes(buffer.data(), buffer.size());
+    boost::iostreams::basic_array_source<char> source(buffer.data(), buffer.size());
+    boost::iostreams::stream<boost::iostreams::basic_array_source<char>> input_stream(source);
+    // Archives throw on truncated input and can be made to allocate arbitrary sizes by a malformed
+    // length, both are reported like any other malformed stream
+    try
+    {
+        boost::archive::binary_iarchive archive(input_stream, boost::archive::no_header | boost::archive::no_tracking);
+        load(archive);
+    }
+    catch (boost::archive::archive_exception const&)
+    {
+        stream.SetError();
+    }
+    catch (std::bad_alloc const&)
+    {
+        stream.SetError();
+    }
+    catch (std::length_error const&)
+    {
+        stream.SetError();
+    }
+}
+
+void INetData::Serialize(NetBitWriter& stream) const
+{
+    SerializeWithArchive(stream, [this](boost::archive::binary_oarchive& archive) { Serialize(archive); });
+}
+
+void INetData::Deserialize(NetBitReader& stream)
+{
+    DeserializeWithArchive(stream, [this](boost::archive::binary_iarchive& archive) { Deserialize(archive); });
+}
+
+void NetSerialize(NetBitWriter& stream, NetTypeID const& typeID)
+{
+    NetDataFactory::GetInstance()->WriteTypeID(stream, typeID);
+}
+
+void NetDeserialize(NetBitReader& stream, NetTypeID& typeID)
+{
+    typeID = NetDataFactory::GetInstance()->ReadTypeID(stream);
+}
+
 void NetDataFactory::Init()
 {
     ms_instance.reset(new NetDataFactory);
@@ -16,15 +95,131 @@ void NetDataFactory::Shutdown()
     ms_instance.reset();
 }
 
+using NetBuiltinTypes = NetTypeList<
+    SessionSetupMessage,
+    SessionTypesAckMessage,
+    TextMessage,
+    SetMasterRequestMessage,
+    SetMasterMessage,
+    MementoUpdateMessage,
+    MementoAckMessage,
+    TextMemento,
+    TextNetObject>;
+
 void NetDataFactory::RegisterData()
 {
-    RegisterDataContainer<SessionSetupMessage>();
-    RegisterDataContainer<TextMessage>();
-    RegisterDataContainer<SetMasterRequestMessage>();
-    RegisterDataContainer<SetMasterMessage>();
-    RegisterDataContainer<MementoUpdateMessage>();
+    RegisterDataContainers(NetBuiltinTypes());
+}
+
+void NetDataFactory::AddType(size_t const typeID, DataFactory const factory)
+{
+    TypeEntry* type = FindType(typeID);
+    if (type)
+    {
+        // the same type registered twice is fine, two types sharing a hash would decode as each other
+        if (type->m_factory != factory)
+        {
+            std::cerr << "NetDataFactory: type ID " << typeID << " is already registered to another type" << std::endl;
+            std::abort();
+        }
+        return;
+    }
 
-    RegisterDataContainer<TextMemento>();
-    
-    RegisterDataContainer<TextNetObject>();
-}
\ No newline at end of file
+    auto const it = std::lower_bound(m_types.begin(), m_types.end(), typeID, [](auto const& entry, size_t const id) { return entry->m_typeID < id; });
+    type = m_types.insert(it, std::make_unique<TypeEntry>(TypeEntry{ typeID, factory, {} }))->get();
+
+    auto const sessionIt = std::lower_bound(m_sessionTypes.begin(), m_sessionTypes.end(), typeID);
+    if (sessionIt != m_sessionTypes.end() && *sessionIt == typeID)
+    {
+        m_sessionEntries[sessionIt - m_sessionTypes.begin()] = type;
+    }
+}
+
+NetDataFactory::TypeEntry* NetDataFactory::FindType(size_t const typeID) const
+{
+    auto const it = std::lower_bound(m_types.begin(), m_types.end(), typeID, [](auto const& entry, size_t const id) { return entry->m_typeID < id; });
+    return it != m_types.end() && (*it)->m_typeID == typeID ? it->get() : nullptr;
+}
+
+void NetDataFactory::ReleaseDataContainer(std::unique_ptr<INetData>&& container)
+{
+    TypeEntry* type = FindType(container->GetTypeID());
+    if (type && type->m_freeContainers.size() < MAX_FREE_CONTAINERS_PER_TYPE)
+    {
+        type->m_freeContainers.push_back(std::move(container));
+    }
+    container.reset();
+}
+
+std::vector<size_t> const& NetDataFactory::GetSessionTypes()
+{
+    if (m_sessionTypes.empty())
+    {
+        std::vector<size_t> typeIDs;
+        for (auto const& type : m_types)
+        {
+            typeIDs.push_back(type->m_typeID);
+        }
+        SetSessionTypes(typeIDs);
+    }
+    return m_sessionTypes;
+}
+
+bool NetDataFactory::SetSessionTypes(std::vector<size_t> const& typeIDs)
+{
+    if (std::adjacent_find(typeIDs.begin(), typeIDs.end(), std::greater_equal<size_t>()) != typeIDs.end())
+    {
+        return false;
+    }
+    m_sessionTypes = typeIDs;
+    m_sessionEntries.clear();
+    for (size_t const typeID : m_sessionTypes)
+    {
+        m_sessionEntries.push_back(FindType(typeID));
+    }
+    return true;
+}
+
+// With type indices the stream holds index + 1, or 0 followed by the hash for types outside the table.
+// Hashes use all 64 bits, so they go out at fixed width rather than as 10 byte varints.
+void NetDataFactory::WriteTypeID(NetBitWriter& stream, size_t const typeID) const
+{
+    if (stream.UsesTypeIndices())
+    {
+        auto const it = std::lower_bound(m_sessionTypes.begin(), m_sessionTypes.end(), typeID);
+        if (it != m_sessionTypes.end() && *it == typeID)
+        {
+            stream.WriteVarUInt(it - m_sessionTypes.begin() + 1);
+            return;
+        }
+        stream.WriteVarUInt(0);
+    }
+    stream.WriteUInt64(typeID);
+}
+
+size_t NetDataFactory::ReadTypeID(NetBitReader& stream) const
+{
+    size_t typeID = 0;
+    ReadType(stream, typeID);
+    return typeID;
+}
+
+NetDataFactory::TypeEntry* NetDataFactory::ReadType(NetBitReader& stream, size_t& typeID) const
+{
+    if (stream.UsesTypeIndices())
+    {
+        uint64_t const index = stream.ReadVarUInt();
+        if (index > m_sessionTypes.size())
+        {
+            stream.SetError();
+            return nullptr;
+        }
+        if (index != 0)
+        {
+            typeID = m_sessionTypes[index - 1];
+            return m_sessionEntries[index - 1];
+        }
+    }
+    typeID = static_cast<size_t>(stream.ReadUInt64());
+    return FindType(typeID);
+}
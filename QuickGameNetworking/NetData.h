@@ -1,37 +1,95 @@
 #pragma once
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
-
-//TODO: replace with some more advanced hash algorithm like crc32
-
-size_t constexpr HashTypeID(const char* p)
+#include <functional>
+#include <optional>
+#include <vector>
+#include "NetBitStream.h"
+#include "NetFieldSchema.h"
+
+// FNV-1a over the type name, evaluated at compile time
+constexpr uint64_t HashTypeID(char const* name)
 {
-    size_t constexpr prime = 31;
-    if (*p)
+    uint64_t hash = 14695981039346656037ull;
+    for (; *name; ++name)
     {
-        return (*p) * prime + HashTypeID(++p);
+        hash = (hash ^ static_cast<uint8_t>(*name)) * 1099511628211ull;
     }
-    return 0;
+    return hash;
 }
 
-
 class INetData
 {
 public:
     virtual size_t GetTypeID() const = 0;
     virtual void Serialize(boost::archive::binary_oarchive& stream) const = 0;
     virtual void Deserialize(boost::archive::binary_iarchive& stream) = 0;
+    // Used on the wire. Defaults to embedding the boost archive so containers that only implement
+    // the boost functions keep working, override both to write fields straight into the bit stream.
+    virtual void Serialize(NetBitWriter& stream) const;
+    virtual void Deserialize(NetBitReader& stream);
     virtual std::unique_ptr<INetData> Clone() const = 0;
     virtual void CopyFrom(INetData const* other) = 0;
+    // Containers that can compare their state let unchanged updates be detected, the default never matches
+    virtual bool Equals(INetData const*) const { return false; }
+    // Writes only what differs from baseline, a container of the same type; the default writes the full state
+    virtual void SerializeDelta(NetBitWriter& stream, INetData const*) const { Serialize(stream); }
+    // Rebuilds the state from baseline and what SerializeDelta wrote
+    virtual void DeserializeDelta(NetBitReader& stream, INetData const*) { Deserialize(stream); }
+    // Same encoding as SerializeDelta with the changed fields given up front
+    virtual void SerializeFields(NetBitWriter& stream, NetFieldMask const) const { Serialize(stream); }
+    // Fields changed since the last ClearDirtyFields, std::nullopt for containers that do not track them
+    virtual std::optional<NetFieldMask> GetDirtyFields() const { return std::nullopt; }
+    virtual void ClearDirtyFields() {}
 };
 
+// Boost compatibility path: a length prefixed boost archive inside the bit stream
+void SerializeWithArchive(NetBitWriter& stream, std::function<void(boost::archive::binary_oarchive&)> const& save);
+void DeserializeWithArchive(NetBitReader& stream, std::function<void(boost::archive::binary_iarchive&)> const& load);
+
+// A type ID field. On streams using type indices it is written as its index in the session
+// type table, one or two bytes instead of the full hash; types missing from it fall back to the hash.
+struct NetTypeID
+{
+    NetTypeID(size_t const value = 0) : m_value(value) {}
+    operator size_t() const { return m_value; }
+
+    size_t m_value;
+
+    template<class Archive> void serialize(Archive& ar, unsigned int const version) { ar & m_value; }
+};
+
+void NetSerialize(NetBitWriter& stream, NetTypeID const& typeID);
+void NetDeserialize(NetBitReader& stream, NetTypeID& typeID);
+
 #define DEFINE_NET_CONTAINER(Type) \
 public: \
-    static constexpr size_t TypeID = HashTypeID(#Type); \
+    static constexpr size_t TypeID = static_cast<size_t>(HashTypeID(#Type)); \
     virtual size_t GetTypeID() const override { return TypeID; } \
     virtual std::unique_ptr<INetData> Clone() const { return std::make_unique<Type>(*this);} \
     virtual void CopyFrom(INetData const* other) {assert(GetTypeID() == other->GetTypeID()); this->~Type(); new (this) Type(*static_cast<Type const*>(other));}
 
+// Compile-time list of container types, registered together by NetDataFactory::RegisterDataContainers
+template<typename... Types>
+struct NetTypeList
+{
+    static constexpr bool HasUniqueTypeIDs()
+    {
+        size_t const typeIDs[] = { Types::TypeID..., 0 };
+        for (size_t i = 0; i < sizeof...(Types); ++i)
+        {
+            for (size_t j = i + 1; j < sizeof...(Types); ++j)
+            {
+                if (typeIDs[i] == typeIDs[j])
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
 class NetDataFactory
 {
 public:
@@ -40,18 +98,60 @@ public:
     static NetDataFactory* GetInstance() { return ms_instance.get(); }
 
     template<typename T> void RegisterDataContainer();
-    template<typename T> bool IsDataContainerRegistered();
+    // Registers every type of the list, their type IDs are checked for collisions at compile time
+    template<typename... Types> void RegisterDataContainers(NetTypeList<Types...>);
+    template<typename T> bool IsDataContainerRegistered() const;
 
     template<typename T = INetData>
-    std::unique_ptr<T> CreateDataContainer(size_t const typeID);
+    std::unique_ptr<T> CreateDataContainer(size_t const typeID) const;
+    // Reads a NetTypeID and makes container one of that type, keeping it when it already is. False for unknown types.
+    template<typename T>
+    bool ReadDataContainer(NetBitReader& stream, std::unique_ptr<T>& container) const;
+
+    // Recycling for containers created and dropped at a high rate, like received messages: Acquire reads a
+    // NetTypeID and hands out a released container of that type if there is one. It keeps the state it was
+    // released with, so it is only fit for deserializing over.
+    template<typename T = INetData>
+    std::unique_ptr<T> AcquireDataContainer(NetBitReader& stream);
+    void ReleaseDataContainer(std::unique_ptr<INetData>&& container);
+
+    // The session type table maps dense indices to type IDs. The host takes it from the types
+    // registered when the first peer joins and hands it to every peer in the session setup.
+    std::vector<size_t> const& GetSessionTypes();
+    // False for a table that is not sorted by type ID, which the host never sends
+    bool SetSessionTypes(std::vector<size_t> const& typeIDs);
+    bool HasSessionTypes() const { return !m_sessionTypes.empty(); }
+
+    void WriteTypeID(NetBitWriter& stream, size_t const typeID) const;
+    size_t ReadTypeID(NetBitReader& stream) const;
 
 private:
+    using DataFactory = std::unique_ptr<INetData>(*)();
+
+    struct TypeEntry
+    {
+        size_t m_typeID;
+        DataFactory m_factory;
+        std::vector<std::unique_ptr<INetData>> m_freeContainers;
+    };
+
     NetDataFactory() = default;
     NetDataFactory(NetDataFactory const& other) = delete;
 
-    void RegisterData();
+    template<typename T> static std::unique_ptr<INetData> Create() { return std::make_unique<T>(); }
 
-    std::unordered_map <size_t, std::function<std::unique_ptr<INetData>()>> m_typeFactory;
+    void RegisterData();
+    void AddType(size_t const typeID, DataFactory const factory);
+    TypeEntry* FindType(size_t const typeID) const;
+    // The type ReadTypeID reads, null if it is not registered here
+    TypeEntry* ReadType(NetBitReader& stream, size_t& typeID) const;
+
+    // Sorted by type ID
+    std::vector<std::unique_ptr<TypeEntry>> m_types;
+    // Sorted as well, so a type's index is found by binary search
+    std::vector<size_t> m_sessionTypes;
+    // Index dispatch for the session types, null for types not registered here
+    std::vector<TypeEntry*> m_sessionEntries;
 
     static std::unique_ptr<NetDataFactory> ms_instance;
 };
@@ -60,24 +160,67 @@ template<typename T>
 void NetDataFactory::RegisterDataContainer()
 {
     static_assert(std::is_base_of<INetData, T>::value, "Can be called only for classes derived from NetMessage");
-    m_typeFactory[T::TypeID] = []() { return std::make_unique<T>(); };
+    AddType(T::TypeID, &Create<T>);
+}
+
+template<typename... Types>
+void NetDataFactory::RegisterDataContainers(NetTypeList<Types...>)
+{
+    static_assert(NetTypeList<Types...>::HasUniqueTypeIDs(), "Type ID collision, rename one of the types");
+    (RegisterDataContainer<Types>(), ...);
 }
 
 template<typename T>
-bool NetDataFactory::IsDataContainerRegistered()
+bool NetDataFactory::IsDataContainerRegistered() const
 {
     static_assert(std::is_base_of<INetData, T>::value, "Can be called only for classes derived from NetMessage");
 
-    return m_typeFactory.find(T::TypeID) != m_typeFactory.end();
+    TypeEntry const* type = FindType(T::TypeID);
+    return type && type->m_factory == &Create<T>;
+}
+
+template<typename T>
+std::unique_ptr<T> NetDataFactory::CreateDataContainer(size_t const typeID) const
+{
+    TypeEntry const* type = FindType(typeID);
+    if (!type)
+    {
+        return nullptr;
+    }
+    return std::unique_ptr<T>(static_cast<T*>(type->m_factory().release()));
+}
+
+template<typename T>
+bool NetDataFactory::ReadDataContainer(NetBitReader& stream, std::unique_ptr<T>& container) const
+{
+    size_t typeID = 0;
+    TypeEntry const* type = ReadType(stream, typeID);
+    if (!type)
+    {
+        container.reset();
+        return false;
+    }
+    if (!container || container->GetTypeID() != typeID)
+    {
+        container.reset(static_cast<T*>(type->m_factory().release()));
+    }
+    return true;
 }
 
 template<typename T>
-std::unique_ptr<T> NetDataFactory::CreateDataContainer(size_t const typeID)
+std::unique_ptr<T> NetDataFactory::AcquireDataContainer(NetBitReader& stream)
 {
-    auto factory = m_typeFactory[typeID];
-    if (!factory)
+    size_t typeID = 0;
+    TypeEntry* type = ReadType(stream, typeID);
+    if (!type)
     {
         return nullptr;
     }
-    return std::unique_ptr<T>(static_cast<T*>(factory().release()));
-}
\ No newline at end of file
+    if (type->m_freeContainers.empty())
+    {
+        return std::unique_ptr<T>(static_cast<T*>(type->m_factory().release()));
+    }
+    std::unique_ptr<INetData> container = std::move(type->m_freeContainers.back());
+    type->m_freeContainers.pop_back();
+    return std::unique_ptr<T>(static_cast<T*>(container.release()));
+}
@@ -0,0 +1,208 @@
+#pragma once
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <cassert>
+#include <limits>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include "NetBitStream.h"
+#include "NetQuantization.h"
+
+// Serialized size of fields that have no upper bound, such as strings
+size_t constexpr NET_UNBOUNDED_BITS = std::numeric_limits<size_t>::max();
+
+constexpr size_t AddMaxBits(size_t const lhs, size_t const rhs)
+{
+    return lhs == NET_UNBOUNDED_BITS || rhs == NET_UNBOUNDED_BITS ? NET_UNBOUNDED_BITS : lhs + rhs;
+}
+
+// One bit per field in declaration order
+using NetFieldMask = uint64_t;
+
+// A codec turns one field into bits: Write, Read, the most bits Write can produce
+// and Equals, which tells whether two values would read back the same
+template<typename T>
+struct NetRawCodec
+{
+    static constexpr size_t MaxBits = std::is_same_v<T, bool> ? 1
+        : std::is_floating_point_v<T> ? 8 * sizeof(T)
+        : std::is_integral_v<T> || std::is_enum_v<T> ? (sizeof(T) > sizeof(uint32_t) ? MAX_VARINT_BITS : 8 * sizeof(T))
+        : NET_UNBOUNDED_BITS;
+
+    static void Write(NetBitWriter& stream, T const& value) { stream << value; }
+    static void Read(NetBitReader& stream, T& value) { stream >> value; }
+    static bool Equals(T const& lhs, T const& rhs) { return lhs == rhs; }
+};
+
+template<typename T>
+struct NetMemberPointerTraits;
+
+template<typename Class, typename Field>
+struct NetMemberPointerTraits<Field Class::*>
+{
+    using OwnerType = Class;
+    using FieldType = Field;
+};
+
+template<auto Member, typename Codec = NetRawCodec<typename NetMemberPointerTraits<decltype(Member)>::FieldType>>
+struct NetField
+{
+    using OwnerType = typename NetMemberPointerTraits<decltype(Member)>::OwnerType;
+    using FieldType = typename NetMemberPointerTraits<decltype(Member)>::FieldType;
+    using CodecType = Codec;
+
+    static constexpr auto MemberPointer = Member;
+    static constexpr size_t MaxBits = Codec::MaxBits;
+
+    static FieldType const& Get(OwnerType const& owner) { return owner.*Member; }
+    static FieldType& Get(OwnerType& owner) { return owner.*Member; }
+
+    static void Write(NetBitWriter& stream, OwnerType const& owner) { Codec::Write(stream, Get(owner)); }
+    static void Read(NetBitReader& stream, OwnerType& owner) { Codec::Read(stream, Get(owner)); }
+    static bool Equals(OwnerType const& lhs, OwnerType const& rhs) { return Codec::Equals(Get(lhs), Get(rhs)); }
+};
+
+template<typename... Fields>
+constexpr size_t NetMaxBitsOf()
+{
+    size_t bits = 0;
+    ((bits = AddMaxBits(bits, Fields::MaxBits)), ...);
+    return bits;
+}
+
+template<auto Lhs, auto Rhs>
+constexpr bool NetIsSameMember()
+{
+    if constexpr (std::is_same_v<decltype(Lhs), decltype(Rhs)>)
+    {
+        return Lhs == Rhs;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Position of Member in Fields, sizeof...(Fields) if it is not listed
+template<auto Member, typename... Fields>
+constexpr size_t NetFieldIndexOf()
+{
+    size_t index = 0;
+    bool found = false;
+    ((found = found || NetIsSameMember<Member, Fields::MemberPointer>(), index += found ? 0 : 1), ...);
+    return index;
+}
+
+// Compile-time list of the fields making up a container's state. Every operation
+// is unrolled over the fields, so there is no virtual dispatch per field.
+template<typename... Fields>
+struct NetFieldList
+{
+    static constexpr size_t MaxBits = NetMaxBitsOf<Fields...>();
+    static constexpr bool IsBounded = MaxBits != NET_UNBOUNDED_BITS;
+    static constexpr size_t MaxBytes = IsBounded ? (MaxBits + 7) / 8 : NET_UNBOUNDED_BITS;
+    static constexpr size_t Count = sizeof...(Fields);
+    static_assert(Count <= 8 * sizeof(NetFieldMask), "Too many fields for a NetFieldMask");
+
+    template<auto Member> static constexpr NetFieldMask MaskOf()
+    {
+        constexpr size_t index = NetFieldIndexOf<Member, Fields...>();
+        static_assert(index < Count, "Member is not a listed net field");
+        return NetFieldMask(1) << index;
+    }
+
+    template<typename T> static void Serialize(NetBitWriter& stream, T const& owner) { (Fields::Write(stream, owner), ...); }
+    template<typename T> static void Deserialize(NetBitReader& stream, T& owner) { (Fields::Read(stream, owner), ...); }
+
+    // Raw boost path for the compatibility archive
+    template<typename T> static void Serialize(boost::archive::binary_oarchive& stream, T const& owner) { ((stream << Fields::Get(owner)), ...); }
+    template<typename T> static void Deserialize(boost::archive::binary_iarchive& stream, T& owner) { ((stream >> Fields::Get(owner)), ...); }
+
+    // Delta encoding: one presence bit per field, followed by the field if its bit is set in mask
+    template<typename T> static void SerializeFields(NetBitWriter& stream, T const& owner, NetFieldMask const mask)
+    {
+        size_t index = 0;
+        ([&]
+        {
+            bool const present = (mask >> index++) & 1;
+            stream.WriteBool(present);
+            if (present)
+            {
+                Fields::Write(stream, owner);
+            }
+        }(), ...);
+    }
+    template<typename T> static NetFieldMask ChangedFields(T const& owner, T const& baseline)
+    {
+        NetFieldMask mask = 0;
+        size_t index = 0;
+        ((mask |= Fields::Equals(owner, baseline) ? 0 : NetFieldMask(1) << index, ++index), ...);
+        return mask;
+    }
+    template<typename T> static void SerializeDelta(NetBitWriter& stream, T const& owner, T const& baseline)
+    {
+        SerializeFields(stream, owner, ChangedFields(owner, baseline));
+    }
+    template<typename T> static void DeserializeDelta(NetBitReader& stream, T& owner, T const& baseline)
+    {
+        Copy(owner, baseline);
+        ([&]
+        {
+            if (stream.ReadBool())
+            {
+                Fields::Read(stream, owner);
+            }
+        }(), ...);
+    }
+
+    template<typename T> static bool Equals(T const& lhs, T const& rhs) { return (Fields::Equals(lhs, rhs) && ...); }
+    template<typename T> static void Copy(T& to, T const& from) { ((Fields::Get(to) = Fields::Get(from)), ...); }
+
+    // Assigns Member and sets its bit in dirty when the value would read back differently
+    template<auto Member, typename T, typename V> static void Set(T& owner, V const& value, NetFieldMask& dirty)
+    {
+        ([&]
+        {
+            if constexpr (NetIsSameMember<Member, Fields::MemberPointer>())
+            {
+                if (!Fields::CodecType::Equals(Fields::Get(owner), value))
+                {
+                    dirty |= MaskOf<Member>();
+                }
+                Fields::Get(owner) = value;
+            }
+        }(), ...);
+    }
+};
+
+// Declares the serialized state of an INetData container, placed after the fields it lists:
+//     DEFINE_NET_FIELDS(NetField<&MyMemento::x>, NetField<&MyMemento::y>);
+// Generates both serialization paths, delta encoding against a baseline, Equals and the MaxSerializedSize bound;
+// NetFields::Copy copies just the listed fields.
+#define DEFINE_NET_FIELDS(...) \
+public: \
+    using NetFields = NetFieldList<__VA_ARGS__>; \
+    static constexpr size_t MaxSerializedSize = NetFields::MaxBytes; \
+    virtual void Serialize(boost::archive::binary_oarchive& stream) const override { NetFields::Serialize(stream, *this); } \
+    virtual void Deserialize(boost::archive::binary_iarchive& stream) override { NetFields::Deserialize(stream, *this); } \
+    virtual void Serialize(NetBitWriter& stream) const override { NetFields::Serialize(stream, *this); } \
+    virtual void Deserialize(NetBitReader& stream) override { NetFields::Deserialize(stream, *this); } \
+    virtual bool Equals(INetData const* other) const override { return GetTypeID() == other->GetTypeID() && NetFields::Equals(*this, *static_cast<decltype(this)>(other)); } \
+    virtual void SerializeDelta(NetBitWriter& stream, INetData const* baseline) const override { assert(GetTypeID() == baseline->GetTypeID()); NetFields::SerializeDelta(stream, *this, *static_cast<decltype(this)>(baseline)); } \
+    virtual void DeserializeDelta(NetBitReader& stream, INetData const* baseline) override { assert(GetTypeID() == baseline->GetTypeID()); NetFields::DeserializeDelta(stream, *this, *static_cast<std::remove_pointer_t<decltype(this)> const*>(baseline)); } \
+    virtual void SerializeFields(NetBitWriter& stream, NetFieldMask const mask) const override { NetFields::SerializeFields(stream, *this, mask); }
+
+// DEFINE_NET_FIELDS plus dirty tracking: fields written through SetField are reported by GetDirtyFields
+// until NetObject sends them, so deltas skip comparing against the baseline. Fields assigned directly
+// are not tracked and may never be sent.
+#define DEFINE_NET_TRACKED_FIELDS(...) \
+    DEFINE_NET_FIELDS(__VA_ARGS__) \
+    template<auto Member, typename V> void SetField(V const& value) { NetFields::Set<Member>(*this, value, m_dirtyFields); } \
+    virtual std::optional<NetFieldMask> GetDirtyFields() const override { return m_dirtyFields; } \
+    virtual void ClearDirtyFields() override { m_dirtyFields = 0; } \
+private: \
+    NetFieldMask m_dirtyFields = 0; \
+public:
@@ -9,8 +9,10 @@ class SessionSetupMessage : public SingletonNetMessageBase
 
 public:
     SessionSetupMessage() = default;
-    SessionSetupMessage(std::vector<NetAddr> connections) : m_connections(connections) {}
+    SessionSetupMessage(std::vector<NetAddr> connections, std::vector<size_t> const& typeIDs) : m_connections(connections), m_typeIDs(typeIDs) {}
     std::vector<NetAddr> m_connections;
+    // The host's session type table
+    std::vector<size_t> m_typeIDs;
 
 private:
     friend class boost::serialization::access;
@@ -21,6 +23,20 @@ private:
     void serialize(Archive & ar, const unsigned int version)
     {
         ar & m_connections;
+        ar & m_typeIDs;
+    }
+};
+
+// Tells a peer this one has the session type table, so type IDs sent to it can be written as indices
+class SessionTypesAckMessage : public SingletonNetMessageBase
+{
+    DEFINE_NET_MESSAGE(SessionTypesAckMessage);
+
+private:
+    friend class boost::serialization::access;
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version)
+    {
     }
 };
 
@@ -77,43 +93,51 @@ private:
     }
 };
 
+// Memento state encoded by the master, either in full or as a delta against an older update the replica acked
 class MementoUpdateMessage : public NetObjectMessageBase
 {
-    DEFINE_NET_CONTAINER(MementoUpdateMessage);
+    DEFINE_NET_MESSAGE(MementoUpdateMessage);
+
 public:
     MementoUpdateMessage() = default;
-    MementoUpdateMessage(std::unique_ptr<INetData>&& data)
-        : m_data(std::move(data))
-    {
-    }
-    MementoUpdateMessage(MementoUpdateMessage const& other)
-        : NetObjectMessageBase(other)
-        , m_data(other.m_data->Clone())
-    {
-    }
+    MementoUpdateMessage(NetTypeID const mementoTypeId, SequenceNumber const sequence, uint8_t const baselineAge, NetData const& payload)
+        : m_mementoTypeId(mementoTypeId), m_sequence(sequence), m_baselineAge(baselineAge), m_payload(payload) {}
 
-    INetData const* GetData() const { return m_data.get(); }
+    NetTypeID m_mementoTypeId;
+    SequenceNumber m_sequence = 0;
+    // How many updates before this one the delta baseline was sent, 0 for a full state
+    uint8_t m_baselineAge = 0;
+    NetData m_payload;
 
 private:
-    virtual void SerializeData(boost::archive::binary_oarchive& stream) const override
+    friend class boost::serialization::access;
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version)
     {
-        stream << m_data->GetTypeID();
-        m_data->Serialize(stream);
+        ar & m_mementoTypeId;
+        ar & m_sequence;
+        ar & m_baselineAge;
+        ar & m_payload;
     }
-    virtual void DeserializeData(boost::archive::binary_iarchive& stream) override
+};
+
+// Sent by a replica for every memento update it applied, so the master can use it as a delta baseline
+class MementoAckMessage : public NetObjectMessageBase
+{
+    DEFINE_NET_MESSAGE(MementoAckMessage);
+
+public:
+    NetTypeID m_mementoTypeId;
+    SequenceNumber m_sequence = 0;
+
+private:
+    friend class boost::serialization::access;
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version)
     {
-        size_t typeId;
-        stream >> typeId;
-        m_data = NetDataFactory::GetInstance()->CreateDataContainer(typeId);
-        assert(m_data);
-        if (!m_data)
-        {
-            return;
-        }
-        m_data->Deserialize(stream);
+        ar & m_mementoTypeId;
+        ar & m_sequence;
     }
-
-    std::unique_ptr<INetData> m_data;
 };
 
 class TextMemento : public INetData
@@ -123,7 +147,5 @@ class TextMemento : public INetData
 public:
     std::string text;
 
-private:
-    virtual void Serialize(boost::archive::binary_oarchive& stream) const override { stream << text; }
-    virtual void Deserialize(boost::archive::binary_iarchive& stream) override { stream >> text; }
+    DEFINE_NET_FIELDS(NetField<&TextMemento::text>);
 };
@@ -11,6 +11,26 @@ void SingletonNetMessageBase::Deserialize(boost::archive::binary_iarchive& strea
     DeserializeData(stream);
 }
 
+void SingletonNetMessageBase::Serialize(NetBitWriter& stream) const
+{
+    SerializeData(stream);
+}
+
+void SingletonNetMessageBase::Deserialize(NetBitReader& stream)
+{
+    DeserializeData(stream);
+}
+
+void SingletonNetMessageBase::SerializeData(NetBitWriter& stream) const
+{
+    SerializeWithArchive(stream, [this](boost::archive::binary_oarchive& archive) { SerializeData(archive); });
+}
+
+void SingletonNetMessageBase::DeserializeData(NetBitReader& stream)
+{
+    DeserializeWithArchive(stream, [this](boost::archive::binary_iarchive& archive) { DeserializeData(archive); });
+}
+
 void NetObjectMessageBase::Serialize(boost::archive::binary_oarchive& stream) const
 {
     stream << m_descriptor;
@@ -21,4 +41,26 @@ void NetObjectMessageBase::Deserialize(boost::archive::binary_iarchive& stream)
 {
     stream >> m_descriptor;
     DeserializeData(stream);
+}
+
+void NetObjectMessageBase::Serialize(NetBitWriter& stream) const
+{
+    m_descriptor.Serialize(stream);
+    SerializeData(stream);
+}
+
+void NetObjectMessageBase::Deserialize(NetBitReader& stream)
+{
+    m_descriptor.Deserialize(stream);
+    DeserializeData(stream);
+}
+
+void NetObjectMessageBase::SerializeData(NetBitWriter& stream) const
+{
+    SerializeWithArchive(stream, [this](boost::archive::binary_oarchive& archive) { SerializeData(archive); });
+}
+
+void NetObjectMessageBase::DeserializeData(NetBitReader& stream)
+{
+    DeserializeWithArchive(stream, [this](boost::archive::binary_iarchive& archive) { DeserializeData(archive); });
 }
\ No newline at end of file
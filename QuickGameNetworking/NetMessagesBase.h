@@ -10,10 +10,14 @@ class SingletonNetMessageBase : public INetMessage
 {
     virtual void SerializeData(boost::archive::binary_oarchive& stream) const = 0;
     virtual void DeserializeData(boost::archive::binary_iarchive& stream) = 0;
+    virtual void SerializeData(NetBitWriter& stream) const;
+    virtual void DeserializeData(NetBitReader& stream);
 
 private:
     virtual void Serialize(boost::archive::binary_oarchive& stream) const override;
     virtual void Deserialize(boost::archive::binary_iarchive& stream) override;
+    virtual void Serialize(NetBitWriter& stream) const override;
+    virtual void Deserialize(NetBitReader& stream) override;
 };
 
 class NetObjectMessageBase : public INetMessage
@@ -24,10 +28,15 @@ public:
 
     virtual void SerializeData(boost::archive::binary_oarchive& stream) const = 0;
     virtual void DeserializeData(boost::archive::binary_iarchive& stream) = 0;
+    // Default to the boost archive, DEFINE_NET_MESSAGE writes fields straight into the bit stream
+    virtual void SerializeData(NetBitWriter& stream) const;
+    virtual void DeserializeData(NetBitReader& stream);
 
 private:
     virtual void Serialize(boost::archive::binary_oarchive& stream) const override;
     virtual void Deserialize(boost::archive::binary_iarchive& stream) override;
+    virtual void Serialize(NetBitWriter& stream) const override;
+    virtual void Deserialize(NetBitReader& stream) override;
 
 private:
     NetObjectDescriptor m_descriptor;
@@ -37,4 +46,6 @@ private:
 DEFINE_NET_CONTAINER(NetMessageType) \
 public: \
     virtual void SerializeData(boost::archive::binary_oarchive& stream) const override { stream << *this; } \
-    virtual void DeserializeData(boost::archive::binary_iarchive& stream) override { stream >> *this; }
+    virtual void DeserializeData(boost::archive::binary_iarchive& stream) override { stream >> *this; } \
+    virtual void SerializeData(NetBitWriter& stream) const override { const_cast<NetMessageType*>(this)->serialize(stream, 0); } \
+    virtual void DeserializeData(NetBitReader& stream) override { serialize(stream, 0); }
@@ -13,7 +13,14 @@ NetObject::NetObject(bool const isMaster, NetObjectDescriptor const& descriptor)
         m_masterData = std::make_unique<NetObjectMasterData>();
     }
     InitMasterDiscovery();
-    RegisterMessageHandler<MementoUpdateMessage>([this](MementoUpdateMessage const& message, NetAddr const& addr) { OnMementoUpdateMessage(message, addr); });
+    if (isMaster)
+    {
+        RegisterMessageHandler<MementoAckMessage>([this](MementoAckMessage const& message, NetAddr const& addr) { OnMementoAckMessage(message, addr); });
+    }
+    else
+    {
+        RegisterMessageHandler<MementoUpdateMessage>([this](MementoUpdateMessage const& message, NetAddr const& addr) { OnMementoUpdateMessage(message, addr); });
+    }
 }
 
 NetObject::~NetObject()
@@ -23,56 +30,58 @@ NetObject::~NetObject()
 
 void NetObject::Update()
 {
-    if (!m_masterAddr)
+    auto const now = std::chrono::system_clock::now();
+    // Requests are reliable but also repeated, the master's object may not exist yet when one arrives
+    if (!m_masterAddr && now - m_lastDiscoveryTime >= std::chrono::milliseconds(DISCOVERY_INTERVAL))
     {
+        m_lastDiscoveryTime = now;
         SendDiscoveryMessage();
     }
     if (IsMaster())
     {
         for (auto&[typeId, memento] : m_mementoes)
         {
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - memento.m_lastUpdateTime).count() > memento.m_updateInterval)
+            if (now - memento.m_lastUpdateTime > std::chrono::milliseconds(memento.m_updateInterval))
             {
-                MementoUpdateMessage update(memento.m_data->Clone());
-                memento.m_lastUpdateTime = std::chrono::system_clock::now();
-                SendMasterBroadcast(update);
+                memento.m_lastUpdateTime = now;
+                SendMementoUpdate(memento, typeId);
             }
         }
     }
 }
 
-void NetObject::SendMasterBroadcast(NetObjectMessageBase& message, ESendOptions const options)
+void NetObject::SendMasterBroadcast(NetObjectMessageBase& message, NetSendParams const& params)
 {
     assert(IsMaster());
-    SendMessageHelper(message, NetObjectAPI::GetInstance()->GetConnections(), options);
+    SendMessageHelper(message, NetObjectAPI::GetInstance()->GetConnections(), params);
 }
 
-void NetObject::SendMasterBroadcastExcluding(NetObjectMessageBase& message, NetAddr const& addr, ESendOptions const options)
+void NetObject::SendMasterBroadcastExcluding(NetObjectMessageBase& message, NetAddr const& addr, NetSendParams const& params)
 {
     assert(IsMaster());
-    SendMessageHelper(message, NetObjectAPI::GetInstance()->GetConnections() | boost::adaptors::filtered([addr](auto const& conn) { return conn != addr; }), options);
+    SendMessageHelper(message, NetObjectAPI::GetInstance()->GetConnections() | boost::adaptors::filtered([addr](auto const& conn) { return conn != addr; }), params);
 }
 
-void NetObject::SendMasterUnicast(NetObjectMessageBase& message, NetAddr const& addr, ESendOptions const options)
+void NetObject::SendMasterUnicast(NetObjectMessageBase& message, NetAddr const& addr, NetSendParams const& params)
 {
     assert(IsMaster());
     auto const replicas = NetObjectAPI::GetInstance()->GetConnections();
     assert(std::find(replicas.begin(), replicas.end(), addr) != replicas.end());
-    SendMessageHelper(message, addr, options);
+    SendMessageHelper(message, addr, params);
 }
 
-void NetObject::SendReplicaMessage(NetObjectMessageBase& message, ESendOptions const options)
+void NetObject::SendReplicaMessage(NetObjectMessageBase& message, NetSendParams const& params)
 {
     assert(!IsMaster());
     if (m_masterAddr)
     {
-        SendMessageHelper(message, *m_masterAddr, options);
+        SendMessageHelper(message, *m_masterAddr, params);
     }
 }
 
-void NetObject::SendToAuthority(NetObjectMessageBase& message, ESendOptions const options)
+void NetObject::SendToAuthority(NetObjectMessageBase& message, NetSendParams const& params)
 {
-    SendMessageHelper(message, NetObjectAPI::GetInstance()->GetHostAddress(), options);
+    SendMessageHelper(message, NetObjectAPI::GetInstance()->GetHostAddress(), params);
 }
 
 void NetObject::ReceiveMessage(INetMessage const& message, NetAddr const& sender)
@@ -107,15 +116,24 @@ void NetObject::OnReplicaAdded(NetAddr const& addr)
 
 void NetObject::OnReplicaLeft(NetAddr const& addr)
 {
+    for (auto&[typeId, memento] : m_mementoes)
+    {
+        memento.m_ackedSequences.erase(addr);
+    }
     if (IsMaster() && m_masterData->m_replicaLeftCallback)
     {
         m_masterData->m_replicaLeftCallback(addr);
     }
 }
 
-void NetObject::SendMessage(NetObjectMessageBase const& message, NetAddr const& addr, ESendOptions const options)
+void NetObject::SendMessage(NetObjectMessageBase const& message, NetAddr const& addr, NetSendParams const& params)
+{
+    NetObjectAPI::GetInstance()->SendMessage(message, addr, params);
+}
+
+void NetObject::BroadcastMessage(NetObjectMessageBase const& message, std::vector<NetAddr> const& addrs, NetSendParams const& params)
 {
-    NetObjectAPI::GetInstance()->SendMessage(message, addr, options);
+    NetObjectAPI::GetInstance()->BroadcastMessage(message, addrs, params);
 }
 
 void NetObject::InitMasterDiscovery()
@@ -125,7 +143,7 @@ void NetObject::InitMasterDiscovery()
         RegisterMessageHandler<SetMasterRequestMessage>([this](SetMasterRequestMessage const& message, NetAddr const addr)
         {
             SetMasterMessage msg;
-            SendMasterUnicast(msg, addr);
+            SendMasterUnicast(msg, addr, ESendOptions::Reliable);
         });
     }
     else
@@ -142,20 +160,215 @@ void NetObject::SendDiscoveryMessage()
     if (!IsMaster())
     {
         SetMasterRequestMessage msg;
-        SendMessageHelper(msg, NetObjectAPI::GetInstance()->GetConnections());
+        SendMessageHelper(msg, NetObjectAPI::GetInstance()->GetConnections(), ESendOptions::Reliable);
+    }
+}
+
+INetData const* NetObjectMemento::FindSnapshot(SequenceNumber const sequence) const
+{
+    NetMementoSnapshot const& snapshot = m_history[sequence % MEMENTO_HISTORY_SIZE];
+    return snapshot.m_data && snapshot.m_sequence == sequence ? snapshot.m_data.get() : nullptr;
+}
+
+void NetObjectMemento::StoreSnapshot(SequenceNumber const sequence, INetData const& data, std::optional<NetFieldMask> const dirtyFields)
+{
+    NetMementoSnapshot& snapshot = m_history[sequence % MEMENTO_HISTORY_SIZE];
+    snapshot.m_sequence = sequence;
+    // the evicted snapshot's container is copied over rather than freed
+    if (snapshot.m_data && snapshot.m_data->GetTypeID() == data.GetTypeID())
+    {
+        snapshot.m_data->CopyFrom(&data);
+    }
+    else
+    {
+        snapshot.m_data = data.Clone();
+    }
+    snapshot.m_dirtyFields = dirtyFields;
+}
+
+std::optional<NetFieldMask> NetObjectMemento::GetDirtyFieldsSince(SequenceNumber const baseline, SequenceNumber const sequence) const
+{
+    NetFieldMask dirtyFields = 0;
+    for (SequenceNumber current = sequence; current != baseline; --current)
+    {
+        NetMementoSnapshot const& snapshot = m_history[current % MEMENTO_HISTORY_SIZE];
+        if (snapshot.m_sequence != current || !snapshot.m_dirtyFields)
+        {
+            return std::nullopt;
+        }
+        dirtyFields |= *snapshot.m_dirtyFields;
+    }
+    return dirtyFields;
+}
+
+bool NetObjectMemento::IsAckedStateCurrent(SequenceNumber const sequence) const
+{
+    if (SequenceDistance(sequence, m_lastSequence) >= MEMENTO_HISTORY_SIZE)
+    {
+        return false;
+    }
+    std::optional<NetFieldMask> const dirtyFields = m_data->GetDirtyFields();
+    if (dirtyFields)
+    {
+        std::optional<NetFieldMask> const sentDirtyFields = GetDirtyFieldsSince(sequence, m_lastSequence);
+        if (sentDirtyFields)
+        {
+            return (*dirtyFields | *sentDirtyFields) == 0;
+        }
+    }
+    INetData const* const acked = FindSnapshot(sequence);
+    return acked && m_data->Equals(acked);
+}
+
+void NetObject::SendMementoUpdate(NetObjectMemento& memento, size_t const typeId)
+{
+    auto const now = std::chrono::system_clock::now();
+    bool const keepAlive = memento.m_keepAliveInterval > 0
+        && now - memento.m_lastSendTime > std::chrono::milliseconds(memento.m_keepAliveInterval);
+
+    // Dormancy: replicas whose acked state is still current get nothing until it changes
+    std::vector<NetAddr> receivers;
+    for (NetAddr const& addr : NetObjectAPI::GetInstance()->GetConnections())
+    {
+        auto const ackedIt = memento.m_ackedSequences.find(addr);
+        if (!keepAlive && ackedIt != memento.m_ackedSequences.end() && memento.IsAckedStateCurrent(ackedIt->second))
+        {
+            m_suppressedMementoUpdates++;
+        }
+        else
+        {
+            receivers.push_back(addr);
+        }
+    }
+    if (receivers.empty())
+    {
+        return;
+    }
+
+    SequenceNumber const sequence = ++memento.m_lastSequence;
+    memento.StoreSnapshot(sequence, *memento.m_data, memento.m_data->GetDirtyFields());
+    memento.m_data->ClearDirtyFields();
+    memento.m_lastSendTime = now;
+
+    // Replicas that acked the same baseline get one message, serialized once for all of them
+    boost::container::flat_map<uint8_t, std::vector<NetAddr>> baselineGroups;
+    for (NetAddr const& addr : receivers)
+    {
+        uint8_t baselineAge = 0;
+        auto const ackedIt = memento.m_ackedSequences.find(addr);
+        if (ackedIt != memento.m_ackedSequences.end())
+        {
+            size_t const age = SequenceDistance(ackedIt->second, sequence);
+            if (age > 0 && age < MEMENTO_HISTORY_SIZE && memento.FindSnapshot(ackedIt->second))
+            {
+                baselineAge = static_cast<uint8_t>(age);
+            }
+        }
+        baselineGroups[baselineAge].push_back(addr);
+    }
+
+    for (auto const&[baselineAge, addrs] : baselineGroups)
+    {
+        SequenceNumber const baselineSequence = static_cast<SequenceNumber>(sequence - baselineAge);
+        INetData const* baseline = baselineAge > 0 ? memento.FindSnapshot(baselineSequence) : nullptr;
+        std::optional<NetFieldMask> const dirtyFields = baseline ? memento.GetDirtyFieldsSince(baselineSequence, sequence) : std::nullopt;
+
+        NetData payload;
+        NetBitWriter stream(payload);
+        if (dirtyFields)
+        {
+            memento.m_data->SerializeFields(stream, *dirtyFields);
+        }
+        else if (baseline)
+        {
+            memento.m_data->SerializeDelta(stream, baseline);
+        }
+        else
+        {
+            memento.m_data->Serialize(stream);
+        }
+        stream.Flush();
+
+        MementoUpdateMessage update(typeId, sequence, baselineAge, payload);
+        // Plain unreliable: replicas drop stale updates by m_sequence, which is per object and memento,
+        // where a sequenced stream would be shared by every object on the connection
+        SendMessageHelper(update, addrs);
     }
 }
 
 void NetObject::OnMementoUpdateMessage(MementoUpdateMessage const& message, NetAddr const& addr)
 {
-    size_t const typeId = message.GetData()->GetTypeID();
-    NetObjectMemento& memento = m_mementoes[typeId];
-    memento.m_data->CopyFrom(message.GetData());
+    auto const mementoIt = m_mementoes.find(message.m_mementoTypeId);
+    if (mementoIt == m_mementoes.end())
+    {
+        return;
+    }
+    NetObjectMemento& memento = mementoIt->second;
+    if (memento.m_hasSequence && !SequenceGreaterThan(message.m_sequence, memento.m_lastSequence))
+    {
+        return;
+    }
+
+    // Deserialized straight into the memento the game reads. A malformed update can leave it partly
+    // updated, the next one overwrites every field since deltas start from a full baseline copy.
+    NetBitReader stream(message.m_payload);
+    if (message.m_baselineAge == 0)
+    {
+        memento.m_data->Deserialize(stream);
+    }
+    else
+    {
+        // The baseline is an update this replica acked, missing only if it was already evicted
+        INetData const* baseline = memento.FindSnapshot(static_cast<SequenceNumber>(message.m_sequence - message.m_baselineAge));
+        if (!baseline)
+        {
+            return;
+        }
+        memento.m_data->DeserializeDelta(stream, baseline);
+    }
+    if (stream.HasError())
+    {
+        return;
+    }
+    memento.m_lastSequence = message.m_sequence;
+    memento.m_hasSequence = true;
+
+    // A full state is acked right away so deltas can start, later ones once per interval. Masters only
+    // use acked updates as baselines, so those are the only ones kept.
+    if (message.m_baselineAge != 0 && memento.m_ackSentSequence && SequenceDistance(*memento.m_ackSentSequence, message.m_sequence) < MEMENTO_ACK_INTERVAL)
+    {
+        return;
+    }
+    memento.StoreSnapshot(message.m_sequence, *memento.m_data);
+    memento.m_ackSentSequence = message.m_sequence;
+    MementoAckMessage ack;
+    ack.m_mementoTypeId = message.m_mementoTypeId;
+    ack.m_sequence = message.m_sequence;
+    SendMessageHelper(ack, addr, ESendOptions::Reliable | ESendOptions::Unordered);
+}
+
+void NetObject::OnMementoAckMessage(MementoAckMessage const& message, NetAddr const& addr)
+{
+    auto const mementoIt = m_mementoes.find(message.m_mementoTypeId);
+    if (mementoIt == m_mementoes.end())
+    {
+        return;
+    }
+    auto& ackedSequences = mementoIt->second.m_ackedSequences;
+    auto const ackedIt = ackedSequences.find(addr);
+    if (ackedIt == ackedSequences.end())
+    {
+        ackedSequences.emplace(addr, message.m_sequence);
+    }
+    else if (SequenceGreaterThan(message.m_sequence, ackedIt->second))
+    {
+        ackedIt->second = message.m_sequence;
+    }
 }
 
 template<>
-void NetObject::SendMessageHelper(NetObjectMessageBase& message, NetAddr const& addr, ESendOptions const options)
+void NetObject::SendMessageHelper(NetObjectMessageBase& message, NetAddr const& addr, NetSendParams const& params)
 {
     message.SetDescriptor(m_descriptor);
-    SendMessage(message, addr, options);
+    SendMessage(message, addr, params);
 }
@@ -5,7 +5,9 @@
 #include "NetObjectDescriptor.h"
 #include <optional>
 #include <functional>
+#include <iterator>
 #include <boost/container/flat_map.hpp>
+#include <array>
 #include <chrono>
 
 
@@ -15,11 +17,48 @@ struct NetObjectMasterData
     std::function<void(NetAddr const&)> m_replicaLeftCallback;
 };
 
+// Updates kept per memento as delta baselines, a replica that acked none of the last ones gets the full state
+size_t constexpr MEMENTO_HISTORY_SIZE = 32;
+static_assert(65536 % MEMENTO_HISTORY_SIZE == 0, "Memento history must divide the sequence range");
+static_assert(MEMENTO_HISTORY_SIZE <= 256, "Baseline age must fit in a byte");
+// Replicas ack every this many updates, leaving room in the history for a few lost acks
+size_t constexpr MEMENTO_ACK_INTERVAL = 8;
+static_assert(MEMENTO_ACK_INTERVAL * 2 < MEMENTO_HISTORY_SIZE, "Memento acks must leave room for loss");
+// Replicas ask for their master this often until one answers
+size_t constexpr DISCOVERY_INTERVAL = 500;
+
+struct NetMementoSnapshot
+{
+    SequenceNumber m_sequence = 0;
+    std::unique_ptr<INetData> m_data;
+    // Fields dirtied since the previous update, for containers that track them
+    std::optional<NetFieldMask> m_dirtyFields;
+};
+
 struct NetObjectMemento
 {
     std::unique_ptr<INetData> m_data;
     size_t m_updateInterval;
+    // Dormant mementos are re-sent this often even if unchanged, 0 to never re-send them
+    size_t m_keepAliveInterval = 0;
     std::chrono::time_point<std::chrono::system_clock> m_lastUpdateTime;
+    std::chrono::time_point<std::chrono::system_clock> m_lastSendTime;
+
+    // Sent updates on the master, acked ones on a replica
+    std::array<NetMementoSnapshot, MEMENTO_HISTORY_SIZE> m_history;
+    SequenceNumber m_lastSequence = 0;
+    bool m_hasSequence = false;
+    // Newest update each replica acked, master only
+    boost::container::flat_map<NetAddr, SequenceNumber> m_ackedSequences;
+    // Last update this replica acked
+    std::optional<SequenceNumber> m_ackSentSequence;
+
+    INetData const* FindSnapshot(SequenceNumber const sequence) const;
+    // Copies data into the history, reusing the container of the snapshot it evicts
+    void StoreSnapshot(SequenceNumber const sequence, INetData const& data, std::optional<NetFieldMask> const dirtyFields = std::nullopt);
+    std::optional<NetFieldMask> GetDirtyFieldsSince(SequenceNumber const baseline, SequenceNumber const sequence) const;
+    // Whether the state acked at sequence still matches m_data, false when it cannot be told
+    bool IsAckedStateCurrent(SequenceNumber const sequence) const;
 };
 
 class NetObject
@@ -35,16 +74,16 @@ public:
 
     void Update();
 
-    void SendMasterBroadcast(NetObjectMessageBase& message, ESendOptions const options = ESendOptions::None);
-    void SendMasterBroadcastExcluding(NetObjectMessageBase& message, NetAddr const& addr, ESendOptions const options = ESendOptions::None);
-    void SendMasterUnicast(NetObjectMessageBase& message, NetAddr const& addr, ESendOptions const options = ESendOptions::None);
-    void SendReplicaMessage(NetObjectMessageBase& message, ESendOptions const options = ESendOptions::None);
-    void SendToAuthority(NetObjectMessageBase& message, ESendOptions const options = ESendOptions::None);
+    void SendMasterBroadcast(NetObjectMessageBase& message, NetSendParams const& params = {});
+    void SendMasterBroadcastExcluding(NetObjectMessageBase& message, NetAddr const& addr, NetSendParams const& params = {});
+    void SendMasterUnicast(NetObjectMessageBase& message, NetAddr const& addr, NetSendParams const& params = {});
+    void SendReplicaMessage(NetObjectMessageBase& message, NetSendParams const& params = {});
+    void SendToAuthority(NetObjectMessageBase& message, NetSendParams const& params = {});
 
     void ReceiveMessage(INetMessage const& message, NetAddr const& sender);
 
     template<typename T> void RegisterMessageHandler(std::function<void(T const&, NetAddr const&)> handler);
-    template<typename T> T* RegisterMemento(size_t const updateInterval = 100);
+    template<typename T> T* RegisterMemento(size_t const updateInterval = 100, size_t const keepAliveInterval = 0);
 
     void SetOnReplicaAddedCallback(std::function<void(NetAddr const&)> const& callback);
     void SetOnReplicaLeftCallback(std::function<void(NetAddr const&)> const& callback);
@@ -52,22 +91,30 @@ public:
     void OnReplicaAdded(NetAddr const& addr);
     void OnReplicaLeft(NetAddr const& addr);
 
+    // Memento updates not sent to a replica because it already had the state
+    size_t GetSuppressedMementoUpdates() const { return m_suppressedMementoUpdates; }
+
 private:
     template<typename ReceiversT>
-    void SendMessageHelper(NetObjectMessageBase& message, ReceiversT const& receivers, ESendOptions const options = ESendOptions::None);
-    void SendMessage(NetObjectMessageBase const& message, NetAddr const& addr, ESendOptions const options = ESendOptions::None);
+    void SendMessageHelper(NetObjectMessageBase& message, ReceiversT const& receivers, NetSendParams const& params = {});
+    void SendMessage(NetObjectMessageBase const& message, NetAddr const& addr, NetSendParams const& params = {});
+    void BroadcastMessage(NetObjectMessageBase const& message, std::vector<NetAddr> const& addrs, NetSendParams const& params = {});
 
     void InitMasterDiscovery();
     void SendDiscoveryMessage();
 
+    void SendMementoUpdate(NetObjectMemento& memento, size_t const typeId);
     void OnMementoUpdateMessage(MementoUpdateMessage const& message, NetAddr const& addr);
+    void OnMementoAckMessage(MementoAckMessage const& message, NetAddr const& addr);
 
 private:
     std::unique_ptr<NetObjectMasterData> m_masterData;
 
     std::optional<NetAddr> m_masterAddr;
+    std::chrono::time_point<std::chrono::system_clock> m_lastDiscoveryTime;
     boost::container::flat_map<size_t, MessageHandler> m_handlers;
     boost::container::flat_map<size_t, NetObjectMemento> m_mementoes;
+    size_t m_suppressedMementoUpdates = 0;
 
     NetObjectDescriptor m_descriptor;
 };
@@ -84,24 +131,22 @@ void NetObject::RegisterMessageHandler(std::function<void(T const&, NetAddr cons
 }
 
 template<typename T>
-T* NetObject::RegisterMemento(size_t const updateInterval)
+T* NetObject::RegisterMemento(size_t const updateInterval, size_t const keepAliveInterval)
 {
     static_assert(std::is_base_of<INetData, T>::value, "Can be called only for classes derived from INetData");
     NetObjectMemento& memento = m_mementoes[T::TypeID];
     memento.m_data = std::make_unique<T>();
     memento.m_updateInterval = updateInterval;
+    memento.m_keepAliveInterval = keepAliveInterval;
     return static_cast<T*>(memento.m_data.get());
 }
 
 template<typename ReceiversT>
-void NetObject::SendMessageHelper(NetObjectMessageBase& message, ReceiversT const& receivers, ESendOptions const options)
+void NetObject::SendMessageHelper(NetObjectMessageBase& message, ReceiversT const& receivers, NetSendParams const& params)
 {
     message.SetDescriptor(m_descriptor);
-    for (auto const& addr : receivers)
-    {
-        SendMessage(message, addr, options);
-    }
+    BroadcastMessage(message, std::vector<NetAddr>(std::begin(receivers), std::end(receivers)), params);
 }
 
 template<>
-void NetObject::SendMessageHelper<NetAddr>(NetObjectMessageBase& message, NetAddr const& addr, ESendOptions const options);
+void NetObject::SendMessageHelper<NetAddr>(NetObjectMessageBase& message, NetAddr const& addr, NetSendParams const& params);
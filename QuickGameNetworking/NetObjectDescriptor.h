@@ -15,6 +15,8 @@ DEFINE_NET_CONTAINER(NetDescriptorDataType) \
 public: \
     virtual void Serialize(boost::archive::binary_oarchive& stream) const override { stream << *this; } \
     virtual void Deserialize(boost::archive::binary_iarchive& stream) override { stream >> *this; } \
+    virtual void Serialize(NetBitWriter& stream) const override { const_cast<NetDescriptorDataType*>(this)->serialize(stream, 0); } \
+    virtual void Deserialize(NetBitReader& stream) override { serialize(stream, 0); } \
 
 #define DEFINE_EMPTY_NET_DESCRIPTOR_DATA(NetDescriptorDataType) \
 class NetDescriptorDataType : public INetObjectDescriptorData \
@@ -42,6 +44,23 @@ public:
 
     bool operator==(NetObjectDescriptor const& other) const { return GetTypeID() == other.GetTypeID() && *m_data == *other.m_data; }
 
+    void Serialize(NetBitWriter& stream) const
+    {
+        stream << NetTypeID(m_data->GetTypeID());
+        m_data->Serialize(stream);
+    }
+
+    void Deserialize(NetBitReader& stream)
+    {
+        // received messages are recycled, so m_data usually has the right type already
+        if (!NetDataFactory::GetInstance()->ReadDataContainer(stream, m_data))
+        {
+            stream.SetError();
+            return;
+        }
+        m_data->Deserialize(stream);
+    }
+
 private:
     std::unique_ptr<INetObjectDescriptorData> m_data;
 
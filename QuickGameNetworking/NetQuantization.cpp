@@ -0,0 +1,72 @@
+#include "NetQuantization.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    uint32_t FloatBits(float const value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float BitsFloat(uint32_t const bits)
+    {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+}
+
+uint16_t NetHalfFloatCodec::Quantize(float const value)
+{
+    uint32_t const infinity = 255 << 23;
+    uint32_t const halfOverflow = (127 + 16) << 23;
+    uint32_t const denormalMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+    uint32_t bits = FloatBits(value);
+    uint32_t const sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint32_t half;
+    if (bits > infinity)
+    {
+        half = 0x7e00;
+    }
+    else if (bits >= halfOverflow)
+    {
+        half = 0x7bff;
+    }
+    else if (bits < (113 << 23))
+    {
+        // below the smallest normal half, let the float adder do the denormal rounding
+        half = FloatBits(BitsFloat(bits) + BitsFloat(denormalMagic)) - denormalMagic;
+    }
+    else
+    {
+        // rebias the exponent and round the mantissa to nearest even
+        uint32_t const mantissaOdd = (bits >> 13) & 1;
+        bits += (uint32_t(15 - 127) << 23) + 0xfff + mantissaOdd;
+        half = std::min<uint32_t>(bits >> 13, 0x7bff);
+    }
+    return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float NetHalfFloatCodec::Dequantize(uint16_t const quantized)
+{
+    uint32_t const exponentMask = 0x7c00 << 13;
+    uint32_t bits = (quantized & 0x7fff) << 13;
+    uint32_t const exponent = bits & exponentMask;
+    bits += (127 - 15) << 23;
+    if (exponent == exponentMask)
+    {
+        bits += (128 - 16) << 23;
+    }
+    else if (exponent == 0)
+    {
+        bits += 1 << 23;
+        bits = FloatBits(BitsFloat(bits) - BitsFloat(113 << 23));
+    }
+    return BitsFloat(bits | ((quantized & 0x8000) << 16));
+}
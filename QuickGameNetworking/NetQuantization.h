@@ -0,0 +1,99 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include "NetBitStream.h"
+
+// Lossy float codecs for NetField. Each one states MaxError, the worst case difference
+// between the value written and the value read back, for inputs inside its range.
+
+// Smallest bit count that keeps the rounding error of [min, max] within precision
+constexpr uint32_t NetBitsForPrecision(double const min, double const max, double const precision)
+{
+    uint32_t bits = 1;
+    while (bits < 32 && (max - min) / ((uint64_t(1) << bits) - 1) / 2 > precision)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+// Range with integral bounds scaled by Denominator, e.g. NetFloatRange<-1, 1, 12, 100> is [-0.01, 0.01] in 12 bits.
+// Ranges with arbitrary bounds are plain structs with the same three constants.
+template<int MinNumerator, int MaxNumerator, uint32_t BitCount, int Denominator = 1>
+struct NetFloatRange
+{
+    static constexpr double Min = static_cast<double>(MinNumerator) / Denominator;
+    static constexpr double Max = static_cast<double>(MaxNumerator) / Denominator;
+    static constexpr uint32_t Bits = BitCount;
+};
+
+// Fixed point over [Range::Min, Range::Max] with round to nearest, values outside are clamped
+template<typename Range>
+struct NetQuantizedFloatCodec
+{
+    static_assert(Range::Bits > 0 && Range::Bits <= 32 && Range::Max > Range::Min, "Invalid quantization range");
+
+    static constexpr size_t MaxBits = Range::Bits;
+    static constexpr uint32_t MaxQuantized = static_cast<uint32_t>((uint64_t(1) << Range::Bits) - 1);
+    static constexpr double Step = (Range::Max - Range::Min) / MaxQuantized;
+    static constexpr double MaxError = Step / 2;
+
+    static uint32_t Quantize(float const value)
+    {
+        // also sends NaN to the bottom of the range
+        if (!(value > Range::Min))
+        {
+            return 0;
+        }
+        if (value >= Range::Max)
+        {
+            return MaxQuantized;
+        }
+        return static_cast<uint32_t>((value - Range::Min) / Step + 0.5);
+    }
+
+    static float Dequantize(uint32_t const quantized) { return static_cast<float>(Range::Min + quantized * Step); }
+
+    static void Write(NetBitWriter& stream, float const& value) { stream.WriteBits(Quantize(value), Range::Bits); }
+    static void Read(NetBitReader& stream, float& value) { value = Dequantize(stream.ReadBits(Range::Bits)); }
+    static bool Equals(float const& lhs, float const& rhs) { return Quantize(lhs) == Quantize(rhs); }
+};
+
+// IEEE 754 half precision: 11 significant bits for values up to 65504, larger ones are clamped.
+// Relative error is at most 2^-11 for magnitudes above 6.1e-5 and absolute error 2^-25 below.
+struct NetHalfFloatCodec
+{
+    static constexpr size_t MaxBits = 16;
+    static constexpr double MaxRelativeError = 1.0 / 2048;
+
+    static uint16_t Quantize(float const value);
+    static float Dequantize(uint16_t const quantized);
+
+    static void Write(NetBitWriter& stream, float const& value) { stream.WriteBits(Quantize(value), 16); }
+    static void Read(NetBitReader& stream, float& value) { value = Dequantize(static_cast<uint16_t>(stream.ReadBits(16))); }
+    static bool Equals(float const& lhs, float const& rhs) { return Quantize(lhs) == Quantize(rhs); }
+};
+
+// Angle in radians wrapped into [0, 2pi), so the value read back may differ from the one written by a multiple of 2pi
+template<uint32_t Bits>
+struct NetAngleCodec
+{
+    static_assert(Bits > 0 && Bits < 32, "Invalid angle precision");
+
+    static constexpr double TwoPi = 6.283185307179586;
+    static constexpr size_t MaxBits = Bits;
+    static constexpr double MaxError = TwoPi / (uint64_t(1) << Bits) / 2;
+
+    static uint32_t Quantize(float const value)
+    {
+        double const turns = value / TwoPi;
+        double const fraction = turns - std::floor(turns);
+        return static_cast<uint32_t>(fraction * (uint64_t(1) << Bits) + 0.5) & ((uint32_t(1) << Bits) - 1);
+    }
+
+    static float Dequantize(uint32_t const quantized) { return static_cast<float>(quantized * TwoPi / (uint64_t(1) << Bits)); }
+
+    static void Write(NetBitWriter& stream, float const& value) { stream.WriteBits(Quantize(value), Bits); }
+    static void Read(NetBitReader& stream, float& value) { value = Dequantize(stream.ReadBits(Bits)); }
+    static bool Equals(float const& lhs, float const& rhs) { return Quantize(lhs) == Quantize(rhs); }
+};
@@ -1,14 +1,10 @@
 #include "NetSocket.h"
 #include <iostream>
+#include <limits>
 #include <boost/range/adaptor/map.hpp>
 #include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/algorithm.hpp>
 #include <boost/range/algorithm_ext.hpp>
-#include <boost/iostreams/device/back_inserter.hpp>
-#include <boost/iostreams/stream.hpp>
-#include <boost/archive/binary_oarchive.hpp>
-#include <boost/archive/binary_iarchive.hpp>
-#include <boost/serialization/vector.hpp>
 
 #ifdef _DEBUG
 size_t constexpr HEARTBEAT_INTERVAL = 5000;
@@ -18,34 +14,182 @@ size_t constexpr HEARTBEAT_INTERVAL = 100;
 size_t constexpr KEEP_AVILE_TIME = 2000;
 #endif
 size_t constexpr RESEND_INTERVAL = 200;
+size_t constexpr DELIVERY_REPORT_INTERVAL = 50;
+size_t constexpr MAX_REDUNDANT_MESSAGES = 8;
+// Upper bound of the packet header plus one message length prefix
+size_t constexpr MAX_HEADER_OVERHEAD = 16;
 size_t constexpr HIHG_PRIORITY_RESEND_INTERVAL = 10;
 size_t constexpr MAX_READ_SIZE = 1024;
+// Decompressed datagrams larger than this are treated as corrupt
+size_t constexpr MAX_DECOMPRESSED_SIZE = 4096;
+size_t constexpr MAX_IN_FLIGHT_PACKETS = 128;
+size_t constexpr MAX_RELIABLE_SEND_QUEUE = 1024;
+// Buffers a connection keeps for parsing received packets and building control packets
+size_t constexpr MAX_FREE_BUFFERS = 64;
+size_t constexpr MAX_UNRELIABLE_SEND_QUEUE = 1024;
+int constexpr RTT_SMOOTHING_FACTOR = 8;
 
+// Packet header: one flags byte, then a 16 bit sequence, an optional stream id, an optional 16 bit
+// stream sequence and a varint payload length. Heartbeats are empty datagrams.
+uint8_t constexpr HEADER_TYPE_MASK = 0x03;
+uint8_t constexpr HEADER_OPTIONS_SHIFT = 2;
+uint8_t constexpr HEADER_OPTIONS_MASK = 0x0f;
+uint8_t constexpr HEADER_HAS_STREAM = 0x40;
+// Everything after the flags byte is deflated
+uint8_t constexpr HEADER_COMPRESSED = 0x80;
+
+namespace
+{
+    void WriteUInt16(NetData& buffer, uint16_t const value)
+    {
+        buffer.push_back(static_cast<char>(value & 0xff));
+        buffer.push_back(static_cast<char>(value >> 8));
+    }
+
+    void WriteVarUInt(NetData& buffer, size_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<char>(value));
+    }
+
+    class HeaderReader
+    {
+    public:
+        HeaderReader(NetData const& data) : m_data(data) {}
+
+        bool ReadByte(uint8_t& value)
+        {
+            if (m_offset >= m_data.size())
+            {
+                return false;
+            }
+            value = static_cast<uint8_t>(m_data[m_offset++]);
+            return true;
+        }
+
+        bool ReadUInt16(uint16_t& value)
+        {
+            uint8_t low, high;
+            if (!ReadByte(low) || !ReadByte(high))
+            {
+                return false;
+            }
+            value = static_cast<uint16_t>(low | (high << 8));
+            return true;
+        }
+
+        bool ReadVarUInt(size_t& value)
+        {
+            value = 0;
+            for (size_t shift = 0; shift < 8 * sizeof(size_t); shift += 7)
+            {
+                uint8_t byte;
+                if (!ReadByte(byte))
+                {
+                    return false;
+                }
+                value |= static_cast<size_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool ReadBytes(size_t const size, NetData& bytes)
+        {
+            if (m_data.size() - m_offset < size)
+            {
+                return false;
+            }
+            bytes.assign(m_data.begin() + m_offset, m_data.begin() + m_offset + size);
+            m_offset += size;
+            return true;
+        }
+
+    private:
+        NetData const& m_data;
+        size_t m_offset = 0;
+    };
+}
 
 NetData NetPacket::Serialize() const
 {
     NetData buffer;
-    boost::iostreams::stream<boost::iostreams::back_insert_device<std::vector<char>> > output_stream(buffer);
-    boost::archive::binary_oarchive stream(output_stream, boost::archive::no_header | boost::archive::no_tracking);
-    stream << m_options;
-    stream << m_ack;
-    stream << m_data;
-    output_stream.flush();
+    NetData const& payload = GetPayload();
+    buffer.reserve(8 + payload.size());
+    uint8_t flags = static_cast<uint8_t>(m_type) | (static_cast<uint8_t>(m_options) << HEADER_OPTIONS_SHIFT);
+    if (m_stream != 0)
+    {
+        flags |= HEADER_HAS_STREAM;
+    }
+    buffer.push_back(static_cast<char>(flags));
+    WriteUInt16(buffer, m_ack);
+    if (m_stream != 0)
+    {
+        buffer.push_back(static_cast<char>(m_stream));
+    }
+    if (HasStreamSequence())
+    {
+        WriteUInt16(buffer, m_streamSequence);
+    }
+    WriteVarUInt(buffer, payload.size());
+    buffer.insert(buffer.end(), payload.begin(), payload.end());
     return buffer;
 }
 
-NetPacket NetPacket::Deserialize(NetData const& data)
+std::optional<NetPacket> NetPacket::Deserialize(NetData const& data, NetData&& payloadBuffer)
 {
-    boost::iostreams::basic_array_source<char> source(data.data(), data.size());
-    boost::iostreams::stream< boost::iostreams::basic_array_source <char> > input_stream(source);
-    boost::archive::binary_iarchive stream(input_stream, boost::archive::no_header | boost::archive::no_tracking);
+    HeaderReader reader(data);
     NetPacket packet;
-    stream >> packet.m_options;
-    stream >> packet.m_ack;
-    stream >> packet.m_data;
+    packet.m_data = std::move(payloadBuffer);
+    uint8_t flags;
+    if (!reader.ReadByte(flags) || !reader.ReadUInt16(packet.m_ack))
+    {
+        return {};
+    }
+    packet.m_type = static_cast<EPacketType>(flags & HEADER_TYPE_MASK);
+    packet.m_options = static_cast<ESendOptions>((flags >> HEADER_OPTIONS_SHIFT) & HEADER_OPTIONS_MASK);
+    bool const reliable = (packet.m_options & ESendOptions::Reliable) != ESendOptions::None;
+    bool const redundant = (packet.m_options & ESendOptions::Redundant) != ESendOptions::None;
+    if (packet.m_type == EPacketType::Ack || (packet.m_type == EPacketType::Skip && !reliable) || (redundant && reliable))
+    {
+        return {};
+    }
+    if ((flags & HEADER_HAS_STREAM) != 0 && !reader.ReadByte(packet.m_stream))
+    {
+        return {};
+    }
+    if (packet.HasStreamSequence() && !reader.ReadUInt16(packet.m_streamSequence))
+    {
+        return {};
+    }
+    size_t size;
+    if (!reader.ReadVarUInt(size) || !reader.ReadBytes(size, packet.m_data))
+    {
+        return {};
+    }
     return packet;
 }
 
+bool NetPacket::HasStreamSequence() const
+{
+    if (m_type != EPacketType::Data && m_type != EPacketType::Skip)
+    {
+        return false;
+    }
+    if ((m_options & ESendOptions::Reliable) != ESendOptions::None)
+    {
+        return (m_options & ESendOptions::Unordered) == ESendOptions::None;
+    }
+    return (m_options & (ESendOptions::Sequenced | ESendOptions::Redundant)) != ESendOptions::None;
+}
+
 bool NetPacket::NeedsResend() const
 {
     auto const lastSendTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - m_lastSentTime).count();
@@ -69,72 +213,650 @@ NetData PacketHelpers::GetHeartbeatPacket()
 
 bool PacketHelpers::IsAck(NetData const& packet)
 {
-    return packet.size() == sizeof(size_t);
+    return !packet.empty() && static_cast<EPacketType>(packet[0] & HEADER_TYPE_MASK) == EPacketType::Ack;
 }
 
-NetData PacketHelpers::GetAckPacket(size_t const ack)
+NetData PacketHelpers::GetAckPacket(SequenceNumber const ack, uint32_t const window)
 {
     NetData buffer;
-    boost::iostreams::stream<boost::iostreams::back_insert_device<std::vector<char>> > output_stream(buffer);
-    boost::archive::binary_oarchive stream(output_stream, boost::archive::no_header | boost::archive::no_tracking);
-    stream << ack;
-    output_stream.flush();
-    assert(buffer.size() == sizeof(size_t));
+    buffer.push_back(static_cast<char>(EPacketType::Ack));
+    WriteUInt16(buffer, ack);
+    WriteVarUInt(buffer, window);
     return buffer;
 }
 
-size_t PacketHelpers::GetAck(NetData const& packet)
+std::optional<std::pair<SequenceNumber, uint32_t>> PacketHelpers::GetAck(NetData const& packet)
+{
+    HeaderReader reader(packet);
+    uint8_t flags;
+    SequenceNumber ack;
+    size_t window;
+    if (!reader.ReadByte(flags) || !reader.ReadUInt16(ack) || !reader.ReadVarUInt(window))
+    {
+        return {};
+    }
+    return { { ack, static_cast<uint32_t>(window) } };
+}
+
+bool PacketHelpers::IsCompressed(NetData const& packet)
 {
-    boost::iostreams::basic_array_source<char> source(packet.data(), packet.size());
-    boost::iostreams::stream< boost::iostreams::basic_array_source <char> > input_stream(source);
-    boost::archive::binary_iarchive stream(input_stream, boost::archive::no_header | boost::archive::no_tracking);
-    size_t ack;;
-    stream >> ack;
-    return ack;
+    return !packet.empty() && (packet[0] & HEADER_COMPRESSED) != 0;
+}
+
+bool PacketHelpers::IsCompressionOffer(NetData const& packet)
+{
+    return IsAck(packet) && ((packet[0] >> HEADER_OPTIONS_SHIFT) & static_cast<uint8_t>(ESendOptions::Sequenced)) != 0;
+}
+
+NetData PacketHelpers::GetCompressionOfferPacket(NetCompressionOffer const& offer)
+{
+    // flags, 32 bit dictionary id, offer bits
+    NetData buffer;
+    buffer.push_back(static_cast<char>(static_cast<uint8_t>(EPacketType::Ack) | (static_cast<uint8_t>(ESendOptions::Sequenced) << HEADER_OPTIONS_SHIFT)));
+    WriteUInt16(buffer, static_cast<uint16_t>(offer.m_dictionaryId & 0xffff));
+    WriteUInt16(buffer, static_cast<uint16_t>(offer.m_dictionaryId >> 16));
+    buffer.push_back(static_cast<char>((offer.m_hasPeerOffer ? 1 : 0) | (offer.m_needsReply ? 2 : 0)));
+    return buffer;
 }
 
-std::optional<NetData> UnreliableChannel::UpdateSend()
+std::optional<NetCompressionOffer> PacketHelpers::GetCompressionOffer(NetData const& packet)
 {
+    HeaderReader reader(packet);
+    uint8_t flags, bits;
+    uint16_t low, high;
+    if (!reader.ReadByte(flags) || !reader.ReadUInt16(low) || !reader.ReadUInt16(high) || !reader.ReadByte(bits))
+    {
+        return {};
+    }
+    NetCompressionOffer offer;
+    offer.m_dictionaryId = low | (static_cast<uint32_t>(high) << 16);
+    offer.m_hasPeerOffer = (bits & 1) != 0;
+    offer.m_needsReply = (bits & 2) != 0;
+    return offer;
+}
+
+bool PacketHelpers::IsRedundantAck(NetData const& packet)
+{
+    return IsAck(packet) && ((packet[0] >> HEADER_OPTIONS_SHIFT) & static_cast<uint8_t>(ESendOptions::Redundant)) != 0;
+}
+
+NetData PacketHelpers::GetRedundantAckPacket(StreamId const stream, SequenceNumber const sequence)
+{
+    NetData buffer;
+    uint8_t flags = static_cast<uint8_t>(EPacketType::Ack) | (static_cast<uint8_t>(ESendOptions::Redundant) << HEADER_OPTIONS_SHIFT);
+    if (stream != 0)
+    {
+        flags |= HEADER_HAS_STREAM;
+    }
+    buffer.push_back(static_cast<char>(flags));
+    WriteUInt16(buffer, sequence);
+    if (stream != 0)
+    {
+        buffer.push_back(static_cast<char>(stream));
+    }
+    return buffer;
+}
+
+std::optional<std::pair<StreamId, SequenceNumber>> PacketHelpers::GetRedundantAck(NetData const& packet)
+{
+    HeaderReader reader(packet);
+    uint8_t flags;
+    SequenceNumber sequence;
+    StreamId stream = 0;
+    if (!reader.ReadByte(flags) || !reader.ReadUInt16(sequence))
+    {
+        return {};
+    }
+    if ((flags & HEADER_HAS_STREAM) != 0 && !reader.ReadByte(stream))
+    {
+        return {};
+    }
+    return { { stream, sequence } };
+}
+
+bool PacketHelpers::IsDeliveryReport(NetData const& packet)
+{
+    return IsAck(packet) && ((packet[0] >> HEADER_OPTIONS_SHIFT) & static_cast<uint8_t>(ESendOptions::Unordered)) != 0;
+}
+
+NetData PacketHelpers::GetDeliveryReportPacket(ESendOptions const channel, NetDeliveryReport const& report, NetData&& buffer)
+{
+    // flags, highest sequence, received count
+    buffer.clear();
+    buffer.push_back(static_cast<char>(static_cast<uint8_t>(EPacketType::Ack) | (static_cast<uint8_t>(channel | ESendOptions::Unordered) << HEADER_OPTIONS_SHIFT)));
+    WriteUInt16(buffer, report.m_highestSequence);
+    WriteUInt16(buffer, report.m_receivedPackets);
+    return std::move(buffer);
+}
+
+std::optional<std::pair<ESendOptions, NetDeliveryReport>> PacketHelpers::GetDeliveryReport(NetData const& packet)
+{
+    HeaderReader reader(packet);
+    uint8_t flags;
+    NetDeliveryReport report;
+    if (!reader.ReadByte(flags) || !reader.ReadUInt16(report.m_highestSequence) || !reader.ReadUInt16(report.m_receivedPackets))
+    {
+        return {};
+    }
+    ESendOptions const channel = static_cast<ESendOptions>((flags >> HEADER_OPTIONS_SHIFT) & HEADER_OPTIONS_MASK) & ESendOptions::Redundant;
+    return { { channel, report } };
+}
+
+ReorderBuffer::EInsertResult ReorderBuffer::Insert(SequenceNumber const sequence, std::optional<NetData>&& data)
+{
+    if (SequenceGreaterThan(m_nextSequence, sequence))
+    {
+        return EInsertResult::Duplicate;
+    }
+    if (SequenceDistance(m_nextSequence, sequence) >= m_slots.size())
+    {
+        return EInsertResult::OutOfWindow;
+    }
+    Slot& slot = GetSlot(sequence);
+    if (slot.m_occupied)
+    {
+        assert(slot.m_sequence == sequence);
+        return EInsertResult::Duplicate;
+    }
+    slot.m_sequence = sequence;
+    slot.m_occupied = true;
+    slot.m_data = std::move(data);
+    return EInsertResult::Stored;
+}
+
+std::optional<NetData> ReorderBuffer::PopNext()
+{
+    for (Slot* slot = &GetSlot(m_nextSequence); slot->m_occupied; slot = &GetSlot(m_nextSequence))
+    {
+        assert(slot->m_sequence == m_nextSequence);
+        slot->m_occupied = false;
+        m_nextSequence++;
+        if (slot->m_data)
+        {
+            std::optional<NetData> data = std::move(slot->m_data);
+            slot->m_data.reset();
+            return data;
+        }
+    }
+    return {};
+}
+
+bool ReceiveWindow::IsDuplicate(SequenceNumber const sequence) const
+{
+    return SequenceGreaterThan(m_base, sequence) || (IsInWindow(sequence) && m_received[sequence % m_received.size()]);
+}
+
+bool ReceiveWindow::IsInWindow(SequenceNumber const sequence) const
+{
+    return SequenceDistance(m_base, sequence) < m_received.size();
+}
+
+void ReceiveWindow::MarkReceived(SequenceNumber const sequence)
+{
+    assert(IsInWindow(sequence));
+    m_received[sequence % m_received.size()] = true;
+    while (m_received[m_base % m_received.size()])
+    {
+        m_received[m_base % m_received.size()] = false;
+        m_base++;
+    }
+}
+
+void ParityEncoder::SetGroupSize(size_t const groupSize)
+{
+    // the whole group has to stay in the receiver's history until its parity arrives
+    assert(groupSize <= PARITY_HISTORY_SIZE);
+    m_groupSize = groupSize;
+    m_count = 0;
+}
+
+std::optional<NetPacket> ParityEncoder::AddPacket(SequenceNumber const ack, NetData const& packet)
+{
+    if (m_count == 0)
+    {
+        m_groupStart = ack;
+        m_lengthParity = 0;
+        m_parity.clear();
+    }
+    assert(ack == static_cast<SequenceNumber>(m_groupStart + m_count));
+    if (packet.size() > m_parity.size())
+    {
+        m_parity.resize(packet.size(), 0);
+    }
+    for (size_t i = 0; i < packet.size(); ++i)
+    {
+        m_parity[i] ^= packet[i];
+    }
+    m_lengthParity ^= static_cast<uint16_t>(packet.size());
+
+    if (++m_count < m_groupSize)
+    {
+        return {};
+    }
+
+    // payload layout: group size, xor of packet lengths, xor of packet bytes
+    NetPacket parity;
+    parity.m_type = EPacketType::Parity;
+    parity.m_options = ESendOptions::None;
+    parity.m_ack = m_groupStart;
+    parity.m_data.reserve(3 + m_parity.size());
+    parity.m_data.push_back(static_cast<char>(m_count));
+    parity.m_data.push_back(static_cast<char>(m_lengthParity & 0xff));
+    parity.m_data.push_back(static_cast<char>(m_lengthParity >> 8));
+    parity.m_data.insert(parity.m_data.end(), m_parity.begin(), m_parity.end());
+    m_count = 0;
+    return parity;
+}
+
+bool ParityDecoder::Contains(SequenceNumber const ack) const
+{
+    Slot const& slot = GetSlot(ack);
+    return slot.m_valid && slot.m_ack == ack;
+}
+
+void ParityDecoder::AddPacket(SequenceNumber const ack, NetData const& packet)
+{
+    // history is kept from the first packet, the parity of a group only arrives after its members
+    Slot& slot = m_history[ack % m_history.size()];
+    slot.m_ack = ack;
+    slot.m_valid = true;
+    slot.m_data = packet;
+    if (!m_hasHighestAck || SequenceGreaterThan(ack, m_highestAck))
+    {
+        m_highestAck = ack;
+        m_hasHighestAck = true;
+    }
+}
+
+void ParityDecoder::AddParity(NetPacket&& parity)
+{
+    if (parity.m_data.size() < 3)
+    {
+        return;
+    }
+    if (!m_hasHighestAck || SequenceGreaterThan(parity.m_ack, m_highestAck))
+    {
+        m_highestAck = parity.m_ack;
+        m_hasHighestAck = true;
+    }
+    m_pendingParities.emplace_back(std::move(parity));
+}
+
+std::optional<NetData> ParityDecoder::TryRecover()
+{
+    auto it = m_pendingParities.begin();
+    while (it != m_pendingParities.end())
+    {
+        NetPacket const& parity = *it;
+        size_t const groupSize = static_cast<uint8_t>(parity.m_data[0]);
+        SequenceNumber const groupEnd = static_cast<SequenceNumber>(parity.m_ack + groupSize);
+
+        size_t received = 0;
+        SequenceNumber missing = 0;
+        for (SequenceNumber ack = parity.m_ack; ack != groupEnd; ++ack)
+        {
+            if (Contains(ack))
+            {
+                received++;
+            }
+            else
+            {
+                missing = ack;
+            }
+        }
+
+        bool const expired = !SequenceGreaterThan(groupEnd, m_highestAck) && SequenceDistance(groupEnd, m_highestAck) >= m_history.size() / 2;
+        if (received == groupSize || expired)
+        {
+            it = m_pendingParities.erase(it);
+            continue;
+        }
+        if (received + 1 < groupSize)
+        {
+            ++it;
+            continue;
+        }
+
+        uint16_t length = static_cast<uint8_t>(parity.m_data[1]) | (static_cast<uint8_t>(parity.m_data[2]) << 8);
+        NetData recovered(parity.m_data.begin() + 3, parity.m_data.end());
+        for (SequenceNumber ack = parity.m_ack; ack != groupEnd; ++ack)
+        {
+            if (ack == missing)
+            {
+                continue;
+            }
+            NetData const& packet = GetSlot(ack).m_data;
+            for (size_t i = 0; i < packet.size(); ++i)
+            {
+                recovered[i] ^= packet[i];
+            }
+            length ^= static_cast<uint16_t>(packet.size());
+        }
+        it = m_pendingParities.erase(it);
+        if (length <= recovered.size())
+        {
+            recovered.resize(length);
+            return recovered;
+        }
+    }
+    return {};
+}
+
+void DeliveryReporter::OnReceived(SequenceNumber const sequence)
+{
+    if (SequenceGreaterThan(sequence, m_report.m_highestSequence))
+    {
+        m_report.m_highestSequence = sequence;
+    }
+    m_report.m_receivedPackets++;
+    m_hasNewPackets = true;
+}
+
+std::optional<NetDeliveryReport> DeliveryReporter::UpdateSend()
+{
+    auto const now = std::chrono::system_clock::now();
+    if (!m_hasNewPackets || now - m_lastReportTime < std::chrono::milliseconds(DELIVERY_REPORT_INTERVAL))
+    {
+        return {};
+    }
+    m_hasNewPackets = false;
+    m_lastReportTime = now;
+    return m_report;
+}
+
+void DeliveryTracker::OnSent(SequenceNumber const sequence, size_t const bytes)
+{
+    m_sentSizes[sequence % DELIVERY_HISTORY_SIZE] = bytes;
+}
+
+void DeliveryTracker::OnReport(NetDeliveryReport const& report, ICongestionController& congestionController)
+{
+    // reports carry running totals, so a lost or reordered one is made up for by the next
+    if (!SequenceGreaterThan(report.m_highestSequence, m_lastReport.m_highestSequence))
+    {
+        return;
+    }
+    size_t const sent = SequenceDistance(m_lastReport.m_highestSequence, report.m_highestSequence);
+    size_t const received = std::min<size_t>(static_cast<uint16_t>(report.m_receivedPackets - m_lastReport.m_receivedPackets), sent);
+    m_lastReport = report;
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < std::min(sent, DELIVERY_HISTORY_SIZE); ++i)
+    {
+        bytes += m_sentSizes[static_cast<SequenceNumber>(report.m_highestSequence - i) % DELIVERY_HISTORY_SIZE];
+    }
+    // the report tells how many packets went missing but not which, so split the bytes by count
+    size_t const ackedBytes = bytes * received / sent;
+    if (ackedBytes > 0)
+    {
+        congestionController.OnPacketAcked(ackedBytes, {});
+    }
+    if (ackedBytes < bytes)
+    {
+        congestionController.OnPacketLost(bytes - ackedBytes);
+    }
+}
+
+void UnreliableChannel::ExpirePackets()
+{
+    auto const now = std::chrono::system_clock::now();
+    size_t const queued = m_sendQueue.size();
+    boost::remove_erase_if(m_sendQueue, [now](NetPacket const& packet) { return packet.IsExpired(now); });
+    m_expiredPackets += queued - m_sendQueue.size();
+}
+
+std::optional<NetData> UnreliableChannel::UpdateSend(size_t const budget)
+{
+    if (m_pendingParity)
+    {
+        if (m_pendingParity->size() > budget)
+        {
+            return {};
+        }
+        NetData send = std::move(*m_pendingParity);
+        m_pendingParity.reset();
+        return send;
+    }
     if (!m_sendQueue.empty())
     {
-        NetPacket const& packet = m_sendQueue.front();
-        NetData const send = packet.Serialize();
-        m_sendQueue.erase(m_sendQueue.begin());
+        auto it = boost::max_element(m_sendQueue, [](NetPacket const& lhs, NetPacket const& rhs) { return lhs.m_priority < rhs.m_priority; });
+        // numbered on the way out so that parity groups cover consecutive packets on the wire
+        it->m_ack = static_cast<SequenceNumber>(m_lastSendAck + 1);
+        NetData const send = it->Serialize();
+        if (send.size() > budget)
+        {
+            return {};
+        }
+        m_lastSendAck++;
+        m_sendQueue.erase(it);
+        m_deliveryTracker.OnSent(m_lastSendAck, send.size());
+        if (m_parityEncoder.IsEnabled())
+        {
+            if (auto parity = m_parityEncoder.AddPacket(m_lastSendAck, send))
+            {
+                m_pendingParity = parity->Serialize();
+            }
+        }
         return send;
     }
     return {};
 }
 
-
 std::optional<NetData> UnreliableChannel::UpdateRecv()
 {
     if (!m_recvQueue.empty())
     {
-        NetPacket const& packet = m_recvQueue.front();
-        NetData const recv = packet.m_data;
+        NetData recv = std::move(m_recvQueue.front().m_data);
         m_recvQueue.erase(m_recvQueue.begin());
         return recv;
     }
     return {};
 }
 
-void UnreliableChannel::AddSend(NetData const& data, ESendOptions const options)
+void UnreliableChannel::AddSend(NetSharedData const& data, NetSendParams const& params)
 {
-    assert((options & ESendOptions::Reliable) == ESendOptions::None);
-    m_sendQueue.emplace_back(data, options, ++m_lastSendAck);
+    assert((params.m_options & ESendOptions::Reliable) == ESendOptions::None);
+    SequenceNumber streamSequence = 0;
+    if ((params.m_options & ESendOptions::Sequenced) != ESendOptions::None)
+    {
+        streamSequence = ++m_lastSendStreamSequences[params.m_stream];
+    }
+    // a backed up lane drops its oldest messages, newer state makes them stale anyway
+    if (m_sendQueue.size() >= MAX_UNRELIABLE_SEND_QUEUE)
+    {
+        m_sendQueue.pop_front();
+        m_droppedPackets++;
+    }
+    m_sendQueue.emplace_back(data, params, 0, streamSequence);
 }
 
-void UnreliableChannel::AddRecv(NetPacket const& packet)
+void UnreliableChannel::AddRecv(NetPacket&& packet, NetData const& data)
 {
     assert((packet.m_options & ESendOptions::Reliable) == ESendOptions::None);
-    if (packet.m_ack > m_lastRecvAck)
+    if (packet.m_type == EPacketType::Parity)
+    {
+        m_parityDecoder.AddParity(std::move(packet));
+    }
+    else if (!m_parityDecoder.Contains(packet.m_ack))
+    {
+        m_parityDecoder.AddPacket(packet.m_ack, data);
+        Receive(std::move(packet));
+    }
+
+    while (auto recovered = m_parityDecoder.TryRecover())
+    {
+        auto recoveredPacket = NetPacket::Deserialize(*recovered);
+        if (!recoveredPacket || recoveredPacket->m_type != EPacketType::Data)
+        {
+            continue;
+        }
+        m_parityDecoder.AddPacket(recoveredPacket->m_ack, *recovered);
+        m_recoveredPackets++;
+        Receive(std::move(*recoveredPacket));
+    }
+}
+
+size_t UnreliableChannel::GetLostPackets() const
+{
+    return m_highestRecvIndex > m_receivedPackets ? m_highestRecvIndex - m_receivedPackets : 0;
+}
+
+void UnreliableChannel::Receive(NetPacket&& packet)
+{
+    // unwrap the 16 bit sequence into a running index for loss accounting
+    if (SequenceGreaterThan(packet.m_ack, m_highestRecvAck))
     {
-        m_lastRecvAck++;
-        m_recvQueue.emplace_back(packet);
+        m_highestRecvIndex += SequenceDistance(m_highestRecvAck, packet.m_ack);
+        m_highestRecvAck = packet.m_ack;
     }
+    m_receivedPackets++;
+    m_deliveryReporter.OnReceived(packet.m_ack);
+    if ((packet.m_options & ESendOptions::Sequenced) != ESendOptions::None)
+    {
+        SequenceNumber& lastRecvSequence = m_lastRecvStreamSequences[packet.m_stream];
+        if (!SequenceGreaterThan(packet.m_streamSequence, lastRecvSequence))
+        {
+            return;
+        }
+        lastRecvSequence = packet.m_streamSequence;
+    }
+    m_recvQueue.emplace_back(std::move(packet));
+}
+
+std::optional<NetData> RedundantChannel::UpdateSendAck()
+{
+    if (!m_pendingAcks.empty())
+    {
+        auto const [stream, sequence] = *m_pendingAcks.begin();
+        m_pendingAcks.erase(m_pendingAcks.begin());
+        return PacketHelpers::GetRedundantAckPacket(stream, sequence);
+    }
+    return {};
 }
 
-std::optional<NetData> ReliableChannel::UpdateSend()
+std::optional<NetData> RedundantChannel::UpdateSend(size_t const budget)
+{
+    for (auto& [stream, sendStream] : m_sendStreams)
+    {
+        if (!sendStream.m_hasNewMessages)
+        {
+            continue;
+        }
+
+        // payload: message count, then each message newest first with its length
+        NetPacket packet(NetData(), NetSendParams(ESendOptions::Redundant, stream), static_cast<SequenceNumber>(m_lastSendAck + 1), sendStream.m_lastSequence);
+        packet.m_data.push_back(0);
+        size_t count = 0;
+        for (auto it = sendStream.m_unacked.rbegin(); it != sendStream.m_unacked.rend(); ++it)
+        {
+            // older messages are left out rather than growing the packet past what the peer reads
+            NetData const& message = **it;
+            if (count > 0 && packet.m_data.size() + message.size() + MAX_HEADER_OVERHEAD > MAX_READ_SIZE)
+            {
+                break;
+            }
+            WriteVarUInt(packet.m_data, message.size());
+            packet.m_data.insert(packet.m_data.end(), message.begin(), message.end());
+            count++;
+        }
+        packet.m_data[0] = static_cast<char>(count);
+
+        NetData send = packet.Serialize();
+        if (send.size() > budget)
+        {
+            return {};
+        }
+        sendStream.m_hasNewMessages = false;
+        m_lastSendAck++;
+        m_deliveryTracker.OnSent(m_lastSendAck, send.size());
+        return send;
+    }
+    return {};
+}
+
+std::optional<NetData> RedundantChannel::UpdateRecv()
+{
+    if (!m_recvQueue.empty())
+    {
+        NetData recv = std::move(m_recvQueue.front());
+        m_recvQueue.erase(m_recvQueue.begin());
+        return recv;
+    }
+    return {};
+}
+
+void RedundantChannel::AddSend(NetSharedData const& data, NetSendParams const& params)
+{
+    assert((params.m_options & ESendOptions::Reliable) == ESendOptions::None);
+    SendStream& sendStream = m_sendStreams[params.m_stream];
+    sendStream.m_unacked.push_back(data);
+    sendStream.m_lastSequence++;
+    sendStream.m_hasNewMessages = true;
+    // messages still unacked after this many newer ones are given up on
+    if (sendStream.m_unacked.size() > MAX_REDUNDANT_MESSAGES)
+    {
+        sendStream.m_unacked.pop_front();
+    }
+}
+
+void RedundantChannel::AddRecv(NetPacket&& packet)
+{
+    HeaderReader reader(packet.m_data);
+    uint8_t count;
+    if (!reader.ReadByte(count) || count == 0)
+    {
+        return;
+    }
+    std::vector<NetData> messages(count);
+    for (NetData& message : messages)
+    {
+        size_t size;
+        if (!reader.ReadVarUInt(size) || !reader.ReadBytes(size, message))
+        {
+            return;
+        }
+    }
+    m_deliveryReporter.OnReceived(packet.m_ack);
+
+    SequenceNumber& lastRecvSequence = m_lastRecvSequences[packet.m_stream];
+    SequenceNumber const newest = packet.m_streamSequence;
+    if (!SequenceGreaterThan(newest, lastRecvSequence))
+    {
+        return;
+    }
+    size_t const newMessages = SequenceDistance(lastRecvSequence, newest);
+    if (newMessages > count)
+    {
+        m_lostMessages += newMessages - count;
+    }
+    for (size_t i = std::min<size_t>(newMessages, count); i > 0; --i)
+    {
+        m_recvQueue.emplace_back(std::move(messages[i - 1]));
+    }
+    lastRecvSequence = newest;
+    m_pendingAcks[packet.m_stream] = newest;
+}
+
+void RedundantChannel::OnAck(StreamId const stream, SequenceNumber const sequence)
+{
+    auto it = m_sendStreams.find(stream);
+    if (it == m_sendStreams.end())
+    {
+        return;
+    }
+    SendStream& sendStream = it->second;
+    if (SequenceGreaterThan(sequence, sendStream.m_lastSequence))
+    {
+        return;
+    }
+    size_t const stillUnacked = SequenceDistance(sequence, sendStream.m_lastSequence);
+    while (sendStream.m_unacked.size() > stillUnacked)
+    {
+        sendStream.m_unacked.pop_front();
+    }
+}
+
+std::optional<NetData> ReliableChannel::UpdateSendAck()
 {
     if (!m_ackQueue.empty())
     {
@@ -142,14 +864,45 @@ std::optional<NetData> ReliableChannel::UpdateSend()
         m_ackQueue.erase(m_ackQueue.begin());
         return send;
     }
+    return {};
+}
+
+std::optional<NetData> ReliableChannel::UpdateSend(size_t const budget, ICongestionController& congestionController)
+{
+    if (m_sendQueue.empty())
+    {
+        return {};
+    }
 
-    auto it = boost::find_if(m_sendQueue, [](NetPacket const& packet) { return packet.NeedsResend(); });
-    if (it != m_sendQueue.end())
+    SequenceNumber const windowStart = m_sendQueue.front().m_ack;
+    size_t const window = GetSendWindow();
+    auto best = m_sendQueue.end();
+    for (auto it = m_sendQueue.begin(); it != m_sendQueue.end() && SequenceDistance(windowStart, it->m_ack) < window; ++it)
+    {
+        if (it->NeedsResend() && (best == m_sendQueue.end() || it->m_priority > best->m_priority))
+        {
+            best = it;
+        }
+    }
+    if (best != m_sendQueue.end())
     {
-        NetPacket& packet = *it;
+        NetPacket& packet = *best;
         NetData send = packet.Serialize();
         assert((packet.m_options & ESendOptions::Reliable) != ESendOptions::None);
+        if (send.size() > budget)
+        {
+            return {};
+        }
+        // Only a newer packet getting through shows this one was dropped. A peer that holds packets back
+        // because its window is closed acks nothing newer, so probes and window-blocked resends are not loss.
+        if (packet.m_sendCount > 0 && m_hasHighestAck && SequenceGreaterThan(m_highestAck, packet.m_ack))
+        {
+            m_lostPackets++;
+            congestionController.OnPacketLost(packet.m_sentSize);
+        }
         packet.UpdateSendTime();
+        packet.m_sendCount++;
+        packet.m_sentSize = send.size();
         return send;
     }
 
@@ -158,69 +911,193 @@ std::optional<NetData> ReliableChannel::UpdateSend()
 
 std::optional<NetData> ReliableChannel::UpdateRecv()
 {
-    if (!m_recvQueue.empty())
+    if (!m_unorderedRecvQueue.empty())
+    {
+        NetData recv = std::move(m_unorderedRecvQueue.front());
+        m_unorderedRecvQueue.pop_front();
+        m_bufferedPackets--;
+        return recv;
+    }
+    for (auto& [stream, recvBuffer] : m_recvStreams)
     {
-        NetPacket recv = *m_recvQueue.begin();
-        assert((recv.m_options & ESendOptions::Reliable) != ESendOptions::None);
-        if (recv.m_ack == m_lastRecvAck)
+        if (auto recv = recvBuffer.PopNext())
         {
-            m_lastRecvAck++;
-            m_recvQueue.erase(m_recvQueue.begin());
-            return recv.m_data;
+            m_bufferedPackets--;
+            return recv;
         }
     }
     return {};
 }
 
-void ReliableChannel::AddSend(NetData const& data, ESendOptions const options)
+bool ReliableChannel::AddSend(NetSharedData const& data, NetSendParams const& params)
 {
-    assert((options & ESendOptions::Reliable) != ESendOptions::None);
-    m_sendQueue.emplace_back(data, options, ++m_lastSendAck);
+    assert((params.m_options & ESendOptions::Reliable) != ESendOptions::None);
+    if (m_sendQueue.size() >= MAX_RELIABLE_SEND_QUEUE)
+    {
+        return false;
+    }
+    bool const ordered = (params.m_options & ESendOptions::Unordered) == ESendOptions::None;
+    SequenceNumber const ack = ++m_lastSendAck;
+    m_sendQueue.emplace_back(data, params, ack, ordered ? ++m_lastSendStreamSequences[params.m_stream] : SequenceNumber(0));
+    return true;
 }
 
-void ReliableChannel::AddRecv(NetPacket const& packet)
+void ReliableChannel::AddRecv(NetPacket&& packet)
 {
     assert((packet.m_options & ESendOptions::Reliable) != ESendOptions::None);
-    m_ackQueue.emplace_back(PacketHelpers::GetAckPacket(packet.m_ack));
-    if (packet.m_ack >= m_lastRecvAck && boost::find_if(m_recvQueue, [ack = packet.m_ack](NetPacket const& recv){return recv.m_ack == ack; }) == m_recvQueue.end())
+    SequenceNumber const ack = packet.m_ack;
+    bool const skipped = packet.m_type == EPacketType::Skip;
+    if (!m_recvWindow.IsDuplicate(ack))
     {
-        m_recvQueue.insert(packet);
+        // packets beyond the window stay unacked so the sender resends them once there is room
+        if (!m_recvWindow.IsInWindow(ack))
+        {
+            return;
+        }
+        if ((packet.m_options & ESendOptions::Unordered) != ESendOptions::None)
+        {
+            if (!skipped)
+            {
+                // the window has already slid past delivered sequences, so an application that falls
+                // behind is held back here; the packet stays unacked and is resent once it drains
+                if (m_bufferedPackets >= RELIABLE_WINDOW_SIZE)
+                {
+                    return;
+                }
+                m_unorderedRecvQueue.emplace_back(std::move(packet.m_data));
+                m_bufferedPackets++;
+            }
+        }
+        else
+        {
+            std::optional<NetData> data;
+            if (!skipped)
+            {
+                data = std::move(packet.m_data);
+            }
+            auto const result = m_recvStreams[packet.m_stream].Insert(packet.m_streamSequence, std::move(data));
+            if (result == ReorderBuffer::EInsertResult::OutOfWindow)
+            {
+                return;
+            }
+            if (result == ReorderBuffer::EInsertResult::Stored && !skipped)
+            {
+                m_bufferedPackets++;
+            }
+        }
+        m_recvWindow.MarkReceived(ack);
     }
+    // ordered streams buffer independently and can together go past the window, advertise it closed then
+    size_t const window = m_bufferedPackets < RELIABLE_WINDOW_SIZE ? RELIABLE_WINDOW_SIZE - m_bufferedPackets : 0;
+    m_ackQueue.emplace_back(PacketHelpers::GetAckPacket(ack, static_cast<uint32_t>(window)));
 }
 
-void ReliableChannel::OnAck(size_t const ack)
+std::optional<std::chrono::milliseconds> ReliableChannel::OnAck(SequenceNumber const ack, uint32_t const window, ICongestionController& congestionController)
 {
+    // acks can arrive reordered, only the newest one tells the current window
+    if (!m_hasPeerWindowAck || !SequenceGreaterThan(m_peerWindowAck, ack))
+    {
+        m_peerWindow = window;
+        m_peerWindowAck = ack;
+        m_hasPeerWindowAck = true;
+    }
     auto it = boost::find_if(m_sendQueue, [ack](NetPacket const& packet) { return packet.m_ack == ack; });
-    if (it != m_sendQueue.end())
+    if (it == m_sendQueue.end())
     {
-        m_sendQueue.erase(it);
+        return {};
+    }
+    if (!m_hasHighestAck || SequenceGreaterThan(ack, m_highestAck))
+    {
+        m_highestAck = ack;
+        m_hasHighestAck = true;
+    }
+
+    std::optional<std::chrono::milliseconds> rtt;
+    if (it->m_sendCount == 1)
+    {
+        rtt = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - it->m_lastSentTime);
+    }
+    congestionController.OnPacketAcked(it->m_sentSize, rtt);
+    m_sendQueue.erase(it);
+    return rtt;
+}
+
+void ReliableChannel::ExpirePackets()
+{
+    // Expired messages keep their sequence numbers, so they turn into empty skips that are still
+    // delivered reliably and let the receiver advance its window and stream ordering past them
+    auto const now = std::chrono::system_clock::now();
+    for (NetPacket& packet : m_sendQueue)
+    {
+        if (packet.m_type == EPacketType::Data && packet.IsExpired(now))
+        {
+            packet.m_type = EPacketType::Skip;
+            packet.m_data = NetData();
+            packet.m_sharedData.reset();
+            m_expiredPackets++;
+        }
     }
 }
 
+size_t ReliableChannel::GetSendWindow() const
+{
+    // a closed window still lets one packet through so the peer can advertise it reopening
+    return std::max<size_t>(std::min<size_t>(m_peerWindow, MAX_IN_FLIGHT_PACKETS), 1);
+}
+
 NetConnection::NetConnection()
-    : m_lastRecvTime(std::chrono::system_clock::now())
+    : NetConnection(std::make_unique<AimdCongestionController>())
+{
+}
+
+NetConnection::NetConnection(std::unique_ptr<ICongestionController>&& congestionController)
+    : m_congestionController(std::move(congestionController))
+    , m_lastRecvTime(std::chrono::system_clock::now())
+{
+}
+
+void NetConnection::ResetSendBudget()
 {
+    m_congestionController->OnSendTick();
+    m_tickBytesSent = 0;
+    // once per tick rather than per datagram, time to live is not finer grained than the update rate
+    m_reliableChannel.ExpirePackets();
+    m_unreliableChannel.ExpirePackets();
 }
 
 std::optional<NetData> NetConnection::UpdateSend()
 {
     std::optional<NetData> ret;
+    size_t const budget = GetSendBudget();
 
-    if (auto send = m_reliableChannel.UpdateSend())
-    {
-        ret = send;
-    }
-    else if (auto send = m_unreliableChannel.UpdateSend())
+    // Deficit round robin: a lane keeps sending while it has credit left and hands over to the next lane,
+    // which gets a fresh quantum, once it runs out or has nothing to send. Idle lanes do not bank credit.
+    for (size_t i = 0; i <= m_deficits.size() && !ret; ++i)
     {
-        ret = send;
+        int& deficit = m_deficits[m_currentLane];
+        if (deficit > 0)
+        {
+            ret = UpdateSendLane(static_cast<ESendLane>(m_currentLane), budget);
+            if (ret)
+            {
+                deficit -= static_cast<int>(ret->size());
+                break;
+            }
+            deficit = 0;
+        }
+        m_currentLane = (m_currentLane + 1) % m_deficits.size();
+        m_deficits[m_currentLane] += m_schedulerConfig.m_quantums[m_currentLane];
     }
-    else if (NeedToSendHeartbeat())
+
+    if (!ret && NeedToSendHeartbeat())
     {
         ret = PacketHelpers::GetHeartbeatPacket();
     }
 
     if (ret)
     {
+        m_tickBytesSent += ret->size();
+        m_congestionController->OnPacketSent(ret->size());
         m_lastSendTime = std::chrono::system_clock::now();
     }
     return ret;
@@ -232,6 +1109,10 @@ std::optional<NetData> NetConnection::UpdateRecv()
     {
         return recv;
     }
+    if (auto recv = m_redundantChannel.UpdateRecv())
+    {
+        return recv;
+    }
     if (auto recv = m_unreliableChannel.UpdateRecv())
     {
         return recv;
@@ -239,41 +1120,151 @@ std::optional<NetData> NetConnection::UpdateRecv()
     return {};
 }
 
-void NetConnection::AddSend(NetData const& data, ESendOptions const options)
+bool NetConnection::AddSend(NetSharedData const& data, NetSendParams const& params)
 {
-    if ((options & ESendOptions::Reliable) != ESendOptions::None)
+    if ((params.m_options & ESendOptions::Reliable) != ESendOptions::None)
     {
-        m_reliableChannel.AddSend(data, options);
+        return m_reliableChannel.AddSend(data, params);
     }
-    else
+    if ((params.m_options & ESendOptions::Redundant) != ESendOptions::None)
+    {
+        m_redundantChannel.AddSend(data, params);
+        return true;
+    }
+    m_unreliableChannel.AddSend(data, params);
+    return true;
+}
+
+void NetConnection::Compress(NetData& packet)
+{
+    if (!m_compressor || m_peerDictionaryId != m_compressor->GetDictionaryId() || PacketHelpers::IsHeartbeat(packet) || PacketHelpers::IsCompressionOffer(packet))
+    {
+        return;
+    }
+    // swapped with the packet on success, so the buffer keeps the capacity of recent datagrams
+    NetData& compressed = m_compressBuffer;
+    compressed.clear();
+    compressed.push_back(static_cast<char>(packet[0] | HEADER_COMPRESSED));
+    if (m_compressor->Compress(packet.data() + 1, packet.size() - 1, compressed))
     {
-        m_unreliableChannel.AddSend(data, options);
+        m_compressionSavedBytes += packet.size() - compressed.size();
+        packet.swap(compressed);
     }
 }
 
 void NetConnection::AddRecv(NetData const& data)
 {
     m_lastRecvTime = std::chrono::system_clock::now();
+    if (!PacketHelpers::IsCompressed(data))
+    {
+        AddRecvPacket(data);
+        return;
+    }
+    NetData& decompressed = m_decompressBuffer;
+    decompressed.clear();
+    decompressed.push_back(static_cast<char>(data[0] & ~HEADER_COMPRESSED));
+    if (!m_compressor || !m_compressor->Decompress(data.data() + 1, data.size() - 1, decompressed, MAX_DECOMPRESSED_SIZE))
+    {
+        m_droppedCompressedPackets++;
+        return;
+    }
+    AddRecvPacket(decompressed);
+}
+
+void NetConnection::AddRecvPacket(NetData const& data)
+{
     if (PacketHelpers::IsHeartbeat(data))
     {
         return;
     }
+    else if (PacketHelpers::IsCompressionOffer(data))
+    {
+        if (auto const offer = PacketHelpers::GetCompressionOffer(data))
+        {
+            m_peerDictionaryId = offer->m_dictionaryId;
+            m_peerHasOffer = m_peerHasOffer || offer->m_hasPeerOffer;
+            m_replyToOffer = m_replyToOffer || offer->m_needsReply;
+        }
+        return;
+    }
+    else if (PacketHelpers::IsDeliveryReport(data))
+    {
+        if (auto const report = PacketHelpers::GetDeliveryReport(data))
+        {
+            if (report->first == ESendOptions::Redundant)
+            {
+                m_redundantChannel.OnDeliveryReport(report->second, *m_congestionController);
+            }
+            else
+            {
+                m_unreliableChannel.OnDeliveryReport(report->second, *m_congestionController);
+            }
+        }
+        return;
+    }
+    else if (PacketHelpers::IsRedundantAck(data))
+    {
+        if (auto const ack = PacketHelpers::GetRedundantAck(data))
+        {
+            m_redundantChannel.OnAck(ack->first, ack->second);
+        }
+        return;
+    }
     else if (PacketHelpers::IsAck(data))
     {
-        size_t const ack = PacketHelpers::GetAck(data);
-        m_reliableChannel.OnAck(ack);
+        auto const ackData = PacketHelpers::GetAck(data);
+        if (!ackData)
+        {
+            return;
+        }
+        auto const [ack, window] = *ackData;
+        if (auto const rtt = m_reliableChannel.OnAck(ack, window, *m_congestionController))
+        {
+            m_roundTripTime = m_roundTripTime.count() == 0 ? *rtt : (m_roundTripTime * (RTT_SMOOTHING_FACTOR - 1) + *rtt) / RTT_SMOOTHING_FACTOR;
+        }
         return;
     }
 
-    NetPacket const packet = NetPacket::Deserialize(data);
+    auto deserialized = NetPacket::Deserialize(data, AcquireBuffer());
+    if (!deserialized)
+    {
+        return;
+    }
+    NetPacket& packet = *deserialized;
     if ((packet.m_options & ESendOptions::Reliable) != ESendOptions::None)
     {
-        m_reliableChannel.AddRecv(packet);
+        m_reliableChannel.AddRecv(std::move(packet));
+    }
+    else if ((packet.m_options & ESendOptions::Redundant) != ESendOptions::None)
+    {
+        m_redundantChannel.AddRecv(std::move(packet));
     }
     else
     {
-        m_unreliableChannel.AddRecv(packet);
+        m_unreliableChannel.AddRecv(std::move(packet), data);
+    }
+}
+
+void NetConnection::RecycleBuffer(NetData&& buffer)
+{
+    if (buffer.capacity() > 0 && buffer.capacity() <= MAX_DECOMPRESSED_SIZE && m_freeBuffers.size() < MAX_FREE_BUFFERS)
+    {
+        m_freeBuffers.push_back(std::move(buffer));
+    }
+}
+
+NetData NetConnection::AcquireBuffer()
+{
+    NetData buffer;
+    if (!m_freeBuffers.empty())
+    {
+        buffer = std::move(m_freeBuffers.back());
+        m_freeBuffers.pop_back();
+        buffer.clear();
     }
+    // room for any datagram, so a buffer that last held a small control packet does not grow again
+    buffer.reserve(MAX_READ_SIZE);
+    return buffer;
 }
 
 bool NetConnection::IsConnected() const
@@ -281,11 +1272,101 @@ bool NetConnection::IsConnected() const
     return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - m_lastRecvTime).count() < KEEP_AVILE_TIME;
 }
 
+size_t NetConnection::GetSendQueueDepth() const
+{
+    return m_reliableChannel.GetSendQueueDepth();
+}
+
+NetConnectionStats NetConnection::GetStats() const
+{
+    NetConnectionStats stats;
+    stats.m_congestionWindow = m_congestionController->GetCongestionWindow();
+    stats.m_sendQueueDepth = GetSendQueueDepth();
+    stats.m_lostPackets = m_reliableChannel.GetLostPackets();
+    stats.m_lostUnreliablePackets = m_unreliableChannel.GetLostPackets();
+    stats.m_recoveredUnreliablePackets = m_unreliableChannel.GetRecoveredPackets();
+    stats.m_expiredPackets = m_reliableChannel.GetExpiredPackets() + m_unreliableChannel.GetExpiredPackets();
+    stats.m_lostRedundantMessages = m_redundantChannel.GetLostMessages();
+    stats.m_droppedUnreliablePackets = m_unreliableChannel.GetDroppedPackets();
+    stats.m_compressionSavedBytes = m_compressionSavedBytes;
+    stats.m_droppedCompressedPackets = m_droppedCompressedPackets;
+    stats.m_roundTripTime = m_roundTripTime;
+    return stats;
+}
+
 bool NetConnection::NeedToSendHeartbeat() const
 {
     return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - m_lastSendTime).count() >= HEARTBEAT_INTERVAL;
 }
 
+size_t NetConnection::GetSendBudget() const
+{
+    size_t const window = m_congestionController->GetCongestionWindow();
+    return window > m_tickBytesSent ? window - m_tickBytesSent : 0;
+}
+
+std::optional<NetData> NetConnection::UpdateSendLane(ESendLane const lane, size_t const budget)
+{
+    switch (lane)
+    {
+    case ESendLane::Control:
+        // acks are exempt from the congestion budget so the peer's sender never stalls on us
+        if (auto send = m_reliableChannel.UpdateSendAck())
+        {
+            return send;
+        }
+        if (auto send = m_redundantChannel.UpdateSendAck())
+        {
+            return send;
+        }
+        if (auto const report = m_unreliableChannel.UpdateSendReport())
+        {
+            return PacketHelpers::GetDeliveryReportPacket(ESendOptions::None, *report, AcquireBuffer());
+        }
+        if (auto const report = m_redundantChannel.UpdateSendReport())
+        {
+            return PacketHelpers::GetDeliveryReportPacket(ESendOptions::Redundant, *report, AcquireBuffer());
+        }
+        return UpdateSendCompressionOffer();
+    case ESendLane::Reliable:
+        return m_reliableChannel.UpdateSend(budget, *m_congestionController);
+    case ESendLane::Unreliable:
+        if (auto send = m_redundantChannel.UpdateSend(budget))
+        {
+            return send;
+        }
+        return m_unreliableChannel.UpdateSend(budget);
+    default:
+        assert(false);
+        return {};
+    }
+}
+
+void NetConnection::SetCompressor(std::shared_ptr<NetPacketCompressor> const& compressor)
+{
+    m_compressor = compressor;
+    m_peerHasOffer = false;
+    m_lastOfferTime = {};
+}
+
+std::optional<NetData> NetConnection::UpdateSendCompressionOffer()
+{
+    auto const now = std::chrono::system_clock::now();
+    bool const needsReply = m_compressor && !m_peerHasOffer;
+    if (!m_replyToOffer && !(needsReply && now - m_lastOfferTime >= std::chrono::milliseconds(RESEND_INTERVAL)))
+    {
+        return {};
+    }
+    m_replyToOffer = false;
+    m_lastOfferTime = now;
+
+    NetCompressionOffer offer;
+    offer.m_dictionaryId = m_compressor ? m_compressor->GetDictionaryId() : 0;
+    offer.m_hasPeerOffer = m_peerDictionaryId.has_value();
+    offer.m_needsReply = needsReply;
+    return PacketHelpers::GetCompressionOfferPacket(offer);
+}
+
 NetSocket::NetSocket(boost::asio::io_service& io_service)
     : NetSocket(io_service, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0))
 {
@@ -293,14 +1374,20 @@ NetSocket::NetSocket(boost::asio::io_service& io_service)
 
 NetSocket::NetSocket(boost::asio::io_service& io_service, NetAddr endPoint)
     : m_socket(io_service, endPoint)
+    , m_congestionControllerFactory([]() { return std::make_unique<AimdCongestionController>(); })
 {
     m_socket.non_blocking(true);
 }
 
-void NetSocket::SendMessage(NetData message, NetAddr recipient, ESendOptions options)
+bool NetSocket::SendMessage(NetData message, NetAddr recipient, NetSendParams const& params)
+{
+    return SendMessage(std::make_shared<NetData const>(std::move(message)), recipient, params);
+}
+
+bool NetSocket::SendMessage(NetSharedData const& message, NetAddr recipient, NetSendParams const& params)
 {
     auto& conn = GetOrCreateConnection(recipient);
-    conn.AddSend(message, ESendOptions::Reliable);
+    return conn.AddSend(message, params);
 }
 
 std::optional<std::pair<NetData, NetAddr>> NetSocket::RecvMessage()
@@ -310,12 +1397,21 @@ std::optional<std::pair<NetData, NetAddr>> NetSocket::RecvMessage()
         auto recv = connection.UpdateRecv();
         if (recv)
         {
-            return { std::pair(recv.value(), endPoint) };
+            return { std::pair(std::move(*recv), endPoint) };
         }
     }
     return {};
 }
 
+void NetSocket::RecycleBuffer(NetAddr const& sender, NetData&& buffer)
+{
+    auto it = m_connections.find(sender);
+    if (it != m_connections.end())
+    {
+        it->second.RecycleBuffer(std::move(buffer));
+    }
+}
+
 void NetSocket::Connect(NetAddr recipient)
 {
     GetOrCreateConnection(recipient);
@@ -333,16 +1429,76 @@ std::vector<NetAddr> NetSocket::GetConnections() const
     return connections;
 }
 
+size_t NetSocket::GetSendQueueDepth(NetAddr recipient) const
+{
+    auto it = m_connections.find(recipient);
+    return it != m_connections.end() ? it->second.GetSendQueueDepth() : 0;
+}
+
+std::optional<NetConnectionStats> NetSocket::GetConnectionStats(NetAddr recipient) const
+{
+    auto it = m_connections.find(recipient);
+    if (it == m_connections.end())
+    {
+        return {};
+    }
+    return it->second.GetStats();
+}
+
+void NetSocket::SetCongestionControllerFactory(CongestionControllerFactory const& factory)
+{
+    m_congestionControllerFactory = factory;
+}
+
+void NetSocket::SetParityGroupSize(size_t const groupSize)
+{
+    m_parityGroupSize = std::min(groupSize, PARITY_HISTORY_SIZE);
+    for (auto& [endPoint, connection] : m_connections)
+    {
+        connection.SetParityGroupSize(m_parityGroupSize);
+    }
+}
+
+void NetSocket::SetCompressionDictionary(NetData const& dictionary)
+{
+    m_compressor = dictionary.empty() ? nullptr : std::make_shared<NetPacketCompressor>(dictionary);
+    for (auto& [endPoint, connection] : m_connections)
+    {
+        connection.SetCompressor(m_compressor);
+    }
+}
+
+void NetSocket::SetSentPacketObserver(std::function<void(NetData const&)> const& observer)
+{
+    m_sentPacketObserver = observer;
+}
+
+void NetSocket::SetSendSchedulerConfig(SendSchedulerConfig const& config)
+{
+    m_schedulerConfig = config;
+    for (auto& [endPoint, connection] : m_connections)
+    {
+        connection.SetSendSchedulerConfig(config);
+    }
+}
+
 NetConnectionsUpdate NetSocket::Update()
 {
     for (auto& [endPoint, connection] : m_connections)
     {
+        connection.ResetSendBudget();
         while (auto send = connection.UpdateSend())
         {
+            if (m_sentPacketObserver)
+            {
+                m_sentPacketObserver(*send);
+            }
+            connection.Compress(*send);
             boost::system::error_code ignored_error;
             m_socket.send_to(boost::asio::buffer(send.value()),
                 endPoint, 0, ignored_error);
             assert(!ignored_error);
+            connection.RecycleBuffer(std::move(*send));
         }
     }
     ProcessMessages();
@@ -361,19 +1517,19 @@ void NetSocket::ProcessMessages()
 {
     while (true)
     {
-        NetData recv_buf;
-        recv_buf.resize(MAX_READ_SIZE);
+        // Reused for every datagram, connections copy out what they keep
+        m_recvBuffer.resize(MAX_READ_SIZE);
         boost::asio::ip::udp::endpoint sender;
         boost::system::error_code error;
-        size_t bytes = m_socket.receive_from(boost::asio::buffer(recv_buf),
+        size_t bytes = m_socket.receive_from(boost::asio::buffer(m_recvBuffer),
             sender, 0, error);
         if (error)
         {
             break;
         }
-        recv_buf.resize(bytes);
+        m_recvBuffer.resize(bytes);
         auto& conn = GetOrCreateConnection(sender);
-        conn.AddRecv(recv_buf);
+        conn.AddRecv(m_recvBuffer);
     }
 }
 
@@ -395,9 +1551,14 @@ std::vector<NetAddr> NetSocket::PollNewConnections()
 
 NetConnection& NetSocket::GetOrCreateConnection(NetAddr recipient)
 {
-    if (!IsConnected(recipient))
+    auto it = m_connections.find(recipient);
+    if (it == m_connections.end())
     {
         m_newConnections.push_back(recipient);
+        it = m_connections.emplace(recipient, NetConnection(m_congestionControllerFactory())).first;
+        it->second.SetSendSchedulerConfig(m_schedulerConfig);
+        it->second.SetParityGroupSize(m_parityGroupSize);
+        it->second.SetCompressor(m_compressor);
     }
-    return m_connections[recipient];
+    return it->second;
 }
\ No newline at end of file
@@ -4,15 +4,38 @@
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/container/flat_map.hpp>
-#include <boost/container/flat_set.hpp>
 #include <boost/detail/bitmask.hpp>
+#include <array>
+#include <bitset>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <vector>
 #include <chrono>
+#include "NetCompression.h"
+#include "NetCongestionControl.h"
+#include "NetBitStream.h"
 
-
-using NetData = std::vector<char>;
 using NetAddr = boost::asio::ip::udp::endpoint;
+using SequenceNumber = uint16_t;
+using StreamId = uint8_t;
+
+size_t constexpr RELIABLE_WINDOW_SIZE = 256;
+size_t constexpr PARITY_HISTORY_SIZE = 64;
+size_t constexpr DELIVERY_HISTORY_SIZE = 256;
+static_assert(65536 % RELIABLE_WINDOW_SIZE == 0 && 65536 % PARITY_HISTORY_SIZE == 0 && 65536 % DELIVERY_HISTORY_SIZE == 0, "Sequence rings must divide the sequence space to stay aligned across wrap-around");
+
+// Sequences wrap around, a is newer than b if it lies less than half the sequence space ahead
+inline bool SequenceGreaterThan(SequenceNumber const a, SequenceNumber const b)
+{
+    return a != b && static_cast<SequenceNumber>(a - b) < 0x8000;
+}
+
+inline SequenceNumber SequenceDistance(SequenceNumber const from, SequenceNumber const to)
+{
+    return static_cast<SequenceNumber>(to - from);
+}
 
 namespace boost
 {
@@ -42,31 +65,125 @@ namespace boost
 
 BOOST_SERIALIZATION_SPLIT_FREE(NetAddr);
 
+inline void NetSerialize(NetBitWriter& stream, NetAddr const& addr)
+{
+    stream.WriteBits(addr.address().to_v4().to_ulong(), 32);
+    stream.WriteBits(addr.port(), 16);
+}
+
+inline void NetDeserialize(NetBitReader& stream, NetAddr& addr)
+{
+    addr.address(boost::asio::ip::address_v4(stream.ReadBits(32)));
+    addr.port(static_cast<unsigned short>(stream.ReadBits(16)));
+}
+
 enum class ESendOptions
 {
     None = 0,
     Reliable = 1,
+    // Unreliable only: packets older than the newest one received on their stream are dropped
+    Sequenced = 2,
+    // Reliable only: delivered as soon as it arrives instead of waiting for earlier messages on its stream
+    Unordered = 4,
+    // Unreliable only: repeated in every packet of its stream until acked, for inputs that cannot wait for a resend
+    Redundant = 8,
 };
 
 BOOST_BITMASK(ESendOptions);
 
+// Within a send lane higher priority packets always go first
+enum class ESendPriority
+{
+    Low,
+    Normal,
+    High,
+};
+
+struct NetSendParams
+{
+    NetSendParams(ESendOptions const options = ESendOptions::None, StreamId const stream = 0, ESendPriority const priority = ESendPriority::Normal,
+        std::chrono::milliseconds const timeToLive = std::chrono::milliseconds::zero())
+        : m_options(options), m_stream(stream), m_priority(priority), m_timeToLive(timeToLive) {}
+
+    ESendOptions m_options;
+    // Reliable messages are delivered in order only relative to other messages on the same stream
+    StreamId m_stream;
+    ESendPriority m_priority;
+    // Messages not delivered within this time are dropped, zero never expires.
+    // An expired reliable message is replaced by an empty skip so the receiver's ordering moves past it.
+    std::chrono::milliseconds m_timeToLive;
+};
+
+enum class EPacketType
+{
+    Data,
+    Parity,
+    Ack,
+    // Stands in for an expired reliable message
+    Skip,
+};
+
+// Sent until the peer confirms it, so each side learns whether the other holds the same dictionary
+struct NetCompressionOffer
+{
+    // 0 when the sender has no dictionary
+    uint32_t m_dictionaryId = 0;
+    // The sender has received the recipient's offer
+    bool m_hasPeerOffer = false;
+    // The sender still waits for the recipient to confirm it has this offer
+    bool m_needsReply = false;
+};
+
 struct NetPacket
 {
     NetPacket() = default;
-    NetPacket(NetData const& data, ESendOptions const options, size_t const ack) : m_data(data), m_options(options), m_ack(ack) {}
+    NetPacket(NetData const& data, ESendOptions const options, SequenceNumber const ack) : m_data(data), m_options(options), m_ack(ack) {}
+    NetPacket(NetData const& data, NetSendParams const& params, SequenceNumber const ack, SequenceNumber const streamSequence)
+        : NetPacket(NetSharedData(), params, ack, streamSequence)
+    {
+        m_data = data;
+    }
+    NetPacket(NetSharedData const& data, NetSendParams const& params, SequenceNumber const ack, SequenceNumber const streamSequence)
+        : m_sharedData(data), m_options(params.m_options), m_ack(ack), m_stream(params.m_stream), m_streamSequence(streamSequence), m_priority(params.m_priority)
+    {
+        if (params.m_timeToLive.count() > 0)
+        {
+            m_deadline = std::chrono::system_clock::now() + params.m_timeToLive;
+        }
+    }
 
     NetData Serialize() const;
-    static NetPacket Deserialize(NetData const& data);
+    // Returns nothing for malformed or truncated datagrams
+    // The payload is read into payloadBuffer, whose capacity is reused
+    static std::optional<NetPacket> Deserialize(NetData const& data, NetData&& payloadBuffer = NetData());
+
+    bool HasStreamSequence() const;
 
     bool NeedsResend() const;
     void UpdateSendTime();
-
-    bool operator<(NetPacket const& other) const { return m_ack < other.m_ack; }
+    bool IsExpired(std::chrono::system_clock::time_point const now) const { return m_deadline && now >= *m_deadline; }
+    NetData const& GetPayload() const { return m_sharedData ? *m_sharedData : m_data; }
 
     NetData m_data;
+    // Payload of queued messages, used instead of m_data when set
+    NetSharedData m_sharedData;
+    EPacketType m_type = EPacketType::Data;
     ESendOptions m_options;
-    size_t m_ack;
+    SequenceNumber m_ack;
+    StreamId m_stream = 0;
+    SequenceNumber m_streamSequence = 0;
+    ESendPriority m_priority = ESendPriority::Normal;
+    std::optional<std::chrono::system_clock::time_point> m_deadline;
     std::chrono::system_clock::time_point m_lastSentTime;
+    size_t m_sendCount = 0;
+    size_t m_sentSize = 0;
+};
+
+// What the receiver of a channel without per packet acks has seen, both fields wrap at 16 bits
+struct NetDeliveryReport
+{
+    SequenceNumber m_highestSequence = 0;
+    uint16_t m_receivedPackets = 0;
 };
 
 class PacketHelpers
@@ -75,65 +192,347 @@ public:
     static bool IsHeartbeat(NetData const& packet);
     static NetData GetHeartbeatPacket();
     static bool IsAck(NetData const& packet);
-    static NetData GetAckPacket(size_t const ack);
-    static size_t GetAck(NetData const& packet);
+    static NetData GetAckPacket(SequenceNumber const ack, uint32_t const window);
+    static std::optional<std::pair<SequenceNumber, uint32_t>> GetAck(NetData const& packet);
+    static bool IsRedundantAck(NetData const& packet);
+    static NetData GetRedundantAckPacket(StreamId const stream, SequenceNumber const sequence);
+    static std::optional<std::pair<StreamId, SequenceNumber>> GetRedundantAck(NetData const& packet);
+    static bool IsCompressed(NetData const& packet);
+    static bool IsCompressionOffer(NetData const& packet);
+    static NetData GetCompressionOfferPacket(NetCompressionOffer const& offer);
+    static std::optional<NetCompressionOffer> GetCompressionOffer(NetData const& packet);
+    static bool IsDeliveryReport(NetData const& packet);
+    // channel is ESendOptions::None for the unreliable channel or ESendOptions::Redundant
+    static NetData GetDeliveryReportPacket(ESendOptions const channel, NetDeliveryReport const& report, NetData&& buffer = NetData());
+    static std::optional<std::pair<ESendOptions, NetDeliveryReport>> GetDeliveryReport(NetData const& packet);
+};
+
+// Fixed-size ring of received payloads indexed by sequence modulo window.
+// Sequences behind the delivery point or already stored are duplicates.
+// A sequence stored without payload was skipped by the sender and is stepped over on delivery.
+class ReorderBuffer
+{
+public:
+    enum class EInsertResult
+    {
+        Stored,
+        Duplicate,
+        OutOfWindow,
+    };
+
+    EInsertResult Insert(SequenceNumber const sequence, std::optional<NetData>&& data);
+    std::optional<NetData> PopNext();
+
+    SequenceNumber GetNextSequence() const { return m_nextSequence; }
+
+private:
+    struct Slot
+    {
+        SequenceNumber m_sequence = 0;
+        bool m_occupied = false;
+        std::optional<NetData> m_data;
+    };
+
+    Slot& GetSlot(SequenceNumber const sequence) { return m_slots[sequence % m_slots.size()]; }
+
+    std::array<Slot, RELIABLE_WINDOW_SIZE> m_slots;
+    SequenceNumber m_nextSequence = 1;
+};
+
+// Tracks which sequences have arrived, independent of when their payload is delivered
+class ReceiveWindow
+{
+public:
+    bool IsDuplicate(SequenceNumber const sequence) const;
+    bool IsInWindow(SequenceNumber const sequence) const;
+    void MarkReceived(SequenceNumber const sequence);
+
+private:
+    std::bitset<RELIABLE_WINDOW_SIZE> m_received;
+    SequenceNumber m_base = 1;
+};
+
+// XOR parity over groups of consecutively sent packets; any single loss in a group
+// can be rebuilt on the receiver from the parity and the rest of the group
+class ParityEncoder
+{
+public:
+    void SetGroupSize(size_t const groupSize);
+    bool IsEnabled() const { return m_groupSize > 0; }
+
+    // Returns the parity packet once the group is complete
+    std::optional<NetPacket> AddPacket(SequenceNumber const ack, NetData const& packet);
+
+private:
+    size_t m_groupSize = 0;
+    size_t m_count = 0;
+    SequenceNumber m_groupStart = 0;
+    uint16_t m_lengthParity = 0;
+    NetData m_parity;
+};
+
+class ParityDecoder
+{
+public:
+    bool Contains(SequenceNumber const ack) const;
+    void AddPacket(SequenceNumber const ack, NetData const& packet);
+    void AddParity(NetPacket&& parity);
+
+    // Returns the serialized packet rebuilt from a group missing exactly one member
+    std::optional<NetData> TryRecover();
+
+private:
+    struct Slot
+    {
+        SequenceNumber m_ack = 0;
+        bool m_valid = false;
+        NetData m_data;
+    };
+
+    Slot const& GetSlot(SequenceNumber const ack) const { return m_history[ack % m_history.size()]; }
+
+    std::array<Slot, PARITY_HISTORY_SIZE> m_history;
+    std::vector<NetPacket> m_pendingParities;
+    SequenceNumber m_highestAck = 0;
+    bool m_hasHighestAck = false;
+};
+
+// Receiving half of the delivery feedback, reports periodically while new packets arrive
+class DeliveryReporter
+{
+public:
+    void OnReceived(SequenceNumber const sequence);
+    std::optional<NetDeliveryReport> UpdateSend();
+
+private:
+    NetDeliveryReport m_report;
+    bool m_hasNewPackets = false;
+    std::chrono::system_clock::time_point m_lastReportTime;
+};
+
+// Sending half of the delivery feedback, turns the peer's reports into acked and lost bytes
+class DeliveryTracker
+{
+public:
+    void OnSent(SequenceNumber const sequence, size_t const bytes);
+    void OnReport(NetDeliveryReport const& report, ICongestionController& congestionController);
+
+private:
+    std::array<size_t, DELIVERY_HISTORY_SIZE> m_sentSizes = {};
+    NetDeliveryReport m_lastReport;
 };
 
 class UnreliableChannel
 {
 public:
-    std::optional<NetData> UpdateSend();
+    std::optional<NetData> UpdateSend(size_t const budget);
+    std::optional<NetDeliveryReport> UpdateSendReport() { return m_deliveryReporter.UpdateSend(); }
     std::optional<NetData> UpdateRecv();
 
-    void AddSend(NetData const& data, ESendOptions const options);
-    void AddRecv(NetPacket const& packet);
+    void AddSend(NetSharedData const& data, NetSendParams const& params);
+    void AddRecv(NetPacket&& packet, NetData const& data);
+    void OnDeliveryReport(NetDeliveryReport const& report, ICongestionController& congestionController) { m_deliveryTracker.OnReport(report, congestionController); }
+
+    // Sends one parity packet per groupSize packets, 0 disables
+    void SetParityGroupSize(size_t const groupSize) { m_parityEncoder.SetGroupSize(groupSize); }
+    size_t GetRecoveredPackets() const { return m_recoveredPackets; }
+    size_t GetLostPackets() const;
+    size_t GetExpiredPackets() const { return m_expiredPackets; }
+    size_t GetDroppedPackets() const { return m_droppedPackets; }
+    void ExpirePackets();
 
 private:
-    std::vector<NetPacket> m_sendQueue;
+    void Receive(NetPacket&& packet);
+
+private:
+    std::deque<NetPacket> m_sendQueue;
     std::vector<NetPacket> m_recvQueue;
-    size_t m_lastSendAck = 0;
-    size_t m_lastRecvAck = 0;
+    std::optional<NetData> m_pendingParity;
+    SequenceNumber m_lastSendAck = 0;
+    boost::container::flat_map<StreamId, SequenceNumber> m_lastSendStreamSequences;
+    boost::container::flat_map<StreamId, SequenceNumber> m_lastRecvStreamSequences;
+    ParityEncoder m_parityEncoder;
+    ParityDecoder m_parityDecoder;
+    DeliveryTracker m_deliveryTracker;
+    DeliveryReporter m_deliveryReporter;
+    SequenceNumber m_highestRecvAck = 0;
+    size_t m_highestRecvIndex = 0;
+    size_t m_receivedPackets = 0;
+    size_t m_recoveredPackets = 0;
+    size_t m_expiredPackets = 0;
+    size_t m_droppedPackets = 0;
+};
+
+// Each packet carries the newest message of its stream along with the older ones the peer has not acked yet,
+// so a lost packet is covered by the next one instead of waiting for a resend
+class RedundantChannel
+{
+public:
+    std::optional<NetData> UpdateSendAck();
+    std::optional<NetData> UpdateSend(size_t const budget);
+    std::optional<NetDeliveryReport> UpdateSendReport() { return m_deliveryReporter.UpdateSend(); }
+    std::optional<NetData> UpdateRecv();
+
+    void AddSend(NetSharedData const& data, NetSendParams const& params);
+    void AddRecv(NetPacket&& packet);
+    void OnAck(StreamId const stream, SequenceNumber const sequence);
+    void OnDeliveryReport(NetDeliveryReport const& report, ICongestionController& congestionController) { m_deliveryTracker.OnReport(report, congestionController); }
+
+    // Messages that were lost in every packet carrying them
+    size_t GetLostMessages() const { return m_lostMessages; }
+
+private:
+    struct SendStream
+    {
+        // oldest first, the last one has m_lastSequence
+        std::deque<NetSharedData> m_unacked;
+        SequenceNumber m_lastSequence = 0;
+        bool m_hasNewMessages = false;
+    };
+
+    boost::container::flat_map<StreamId, SendStream> m_sendStreams;
+    boost::container::flat_map<StreamId, SequenceNumber> m_lastRecvSequences;
+    boost::container::flat_map<StreamId, SequenceNumber> m_pendingAcks;
+    std::vector<NetData> m_recvQueue;
+    // numbers packets for the delivery feedback, independent of the per stream message sequences
+    SequenceNumber m_lastSendAck = 0;
+    DeliveryTracker m_deliveryTracker;
+    DeliveryReporter m_deliveryReporter;
+    size_t m_lostMessages = 0;
 };
 
 class ReliableChannel
 {
 public:
-    std::optional<NetData> UpdateSend();
+    std::optional<NetData> UpdateSendAck();
+    std::optional<NetData> UpdateSend(size_t const budget, ICongestionController& congestionController);
     std::optional<NetData> UpdateRecv();
 
-    void AddSend(NetData const& data, ESendOptions const options);
-    void AddRecv(NetPacket const& packet);
-    void OnAck(size_t const ack);
+    bool AddSend(NetSharedData const& data, NetSendParams const& params);
+    void AddRecv(NetPacket&& packet);
+    // Returns the round trip time measured by this ack, if it was unambiguous
+    std::optional<std::chrono::milliseconds> OnAck(SequenceNumber const ack, uint32_t const window, ICongestionController& congestionController);
+
+    size_t GetSendQueueDepth() const { return m_sendQueue.size(); }
+    size_t GetLostPackets() const { return m_lostPackets; }
+    size_t GetExpiredPackets() const { return m_expiredPackets; }
+    void ExpirePackets();
+
+private:
+    size_t GetSendWindow() const;
 
 private:
     std::vector<NetPacket> m_sendQueue;
-    boost::container::flat_set<NetPacket> m_recvQueue;
+    boost::container::flat_map<StreamId, SequenceNumber> m_lastSendStreamSequences;
+    ReceiveWindow m_recvWindow;
+    boost::container::flat_map<StreamId, ReorderBuffer> m_recvStreams;
+    std::deque<NetData> m_unorderedRecvQueue;
+    size_t m_bufferedPackets = 0;
     std::vector<NetData> m_ackQueue;
-    size_t m_lastSendAck = 0;
-    size_t m_lastRecvAck = 1;
+    SequenceNumber m_lastSendAck = 0;
+    uint32_t m_peerWindow = RELIABLE_WINDOW_SIZE;
+    // Ack that last set m_peerWindow
+    SequenceNumber m_peerWindowAck = 0;
+    bool m_hasPeerWindowAck = false;
+    SequenceNumber m_highestAck = 0;
+    bool m_hasHighestAck = false;
+    size_t m_lostPackets = 0;
+    size_t m_expiredPackets = 0;
+};
+
+enum class ESendLane
+{
+    Control,
+    Reliable,
+    Unreliable,
+    Count,
+};
+
+struct SendSchedulerConfig
+{
+    // Bytes each lane may send per round-robin turn, which sets its share of a saturated link
+    std::array<int, static_cast<size_t>(ESendLane::Count)> m_quantums = { { 2048, 2048, 2048 } };
+};
+
+struct NetConnectionStats
+{
+    size_t m_congestionWindow = 0;
+    size_t m_sendQueueDepth = 0;
+    size_t m_lostPackets = 0;
+    size_t m_lostUnreliablePackets = 0;
+    size_t m_recoveredUnreliablePackets = 0;
+    // Messages dropped because their time to live ran out
+    size_t m_expiredPackets = 0;
+    size_t m_lostRedundantMessages = 0;
+    // Unreliable messages pushed out of a full send queue by newer ones
+    size_t m_droppedUnreliablePackets = 0;
+    // Bytes compression took off the datagrams sent
+    size_t m_compressionSavedBytes = 0;
+    // Compressed datagrams that could not be inflated, or arrived before compression was set up
+    size_t m_droppedCompressedPackets = 0;
+    std::chrono::milliseconds m_roundTripTime{ 0 };
 };
 
 class NetConnection
 {
 public:
     NetConnection();
+    NetConnection(std::unique_ptr<ICongestionController>&& congestionController);
+
+    // Starts a new update tick, refilling the budget granted by the congestion window
+    // and dropping messages whose time to live ran out
+    void ResetSendBudget();
+    void SetSendSchedulerConfig(SendSchedulerConfig const& config) { m_schedulerConfig = config; }
+    void SetParityGroupSize(size_t const groupSize) { m_unreliableChannel.SetParityGroupSize(groupSize); }
+    // Restarts negotiation, datagrams are compressed once the peer has announced the same dictionary
+    void SetCompressor(std::shared_ptr<NetPacketCompressor> const& compressor);
 
     std::optional<NetData> UpdateSend();
     std::optional<NetData> UpdateRecv();
 
-    void AddSend(NetData const& data, ESendOptions const options);
+    bool AddSend(NetSharedData const& data, NetSendParams const& params);
     void AddRecv(NetData const& data);
+    // Compresses a datagram returned by UpdateSend in place if the peer can read it and it gets smaller
+    void Compress(NetData& packet);
+    // Takes back a datagram that was sent or a message returned by UpdateRecv, received packets are parsed into these
+    void RecycleBuffer(NetData&& buffer);
 
     bool IsConnected() const;
+    size_t GetSendQueueDepth() const;
+    NetConnectionStats GetStats() const;
 
 private:
     bool NeedToSendHeartbeat() const;
+    size_t GetSendBudget() const;
+    std::optional<NetData> UpdateSendLane(ESendLane const lane, size_t const budget);
+    std::optional<NetData> UpdateSendCompressionOffer();
+    void AddRecvPacket(NetData const& data);
+    NetData AcquireBuffer();
 
 private:
     ReliableChannel m_reliableChannel;
     UnreliableChannel m_unreliableChannel;
+    RedundantChannel m_redundantChannel;
+    std::unique_ptr<ICongestionController> m_congestionController;
+    size_t m_tickBytesSent = 0;
+    SendSchedulerConfig m_schedulerConfig;
+    std::array<int, static_cast<size_t>(ESendLane::Count)> m_deficits = {};
+    size_t m_currentLane = 0;
+    std::chrono::milliseconds m_roundTripTime{ 0 };
     std::chrono::system_clock::time_point m_lastSendTime;
     std::chrono::system_clock::time_point m_lastRecvTime;
+
+    std::shared_ptr<NetPacketCompressor> m_compressor;
+    std::optional<uint32_t> m_peerDictionaryId;
+    bool m_peerHasOffer = false;
+    bool m_replyToOffer = false;
+    std::chrono::system_clock::time_point m_lastOfferTime;
+    // Reused for every datagram instead of allocating one per packet
+    NetData m_compressBuffer;
+    NetData m_decompressBuffer;
+    std::vector<NetData> m_freeBuffers;
+    size_t m_compressionSavedBytes = 0;
+    size_t m_droppedCompressedPackets = 0;
 };
 
 struct NetConnectionsUpdate
@@ -148,12 +547,30 @@ public:
     NetSocket(boost::asio::io_service& io_service);
     NetSocket(boost::asio::io_service& io_service, NetAddr endPoint);
 
-    void SendMessage(NetData message, NetAddr recipient, ESendOptions options);
+    // Returns false when the recipient's send queue is full and the message was dropped
+    bool SendMessage(NetData message, NetAddr recipient, NetSendParams const& params);
+    bool SendMessage(NetSharedData const& message, NetAddr recipient, NetSendParams const& params);
     std::optional<std::pair<NetData, NetAddr>> RecvMessage();
+    // Hands a message returned by RecvMessage back once it has been read, so its buffer is reused
+    void RecycleBuffer(NetAddr const& sender, NetData&& buffer);
 
     void Connect(NetAddr recipient);
     bool IsConnected(NetAddr recipient) const;
     std::vector<NetAddr> GetConnections() const;
+    size_t GetSendQueueDepth(NetAddr recipient) const;
+    std::optional<NetConnectionStats> GetConnectionStats(NetAddr recipient) const;
+
+    // Applies to connections created afterwards
+    void SetCongestionControllerFactory(CongestionControllerFactory const& factory);
+    void SetSendSchedulerConfig(SendSchedulerConfig const& config);
+    // Forward error correction for unreliable traffic: one parity packet per groupSize packets, 0 disables.
+    // Groups are capped at PARITY_HISTORY_SIZE packets.
+    void SetParityGroupSize(size_t const groupSize);
+    // Deflates datagrams with a preset dictionary, see TrainCompressionDictionary. Peers only compress
+    // towards each other once both have set the same dictionary, an empty one disables compression.
+    void SetCompressionDictionary(NetData const& dictionary);
+    // Sees every datagram before compression, for capturing dictionary training samples
+    void SetSentPacketObserver(std::function<void(NetData const&)> const& observer);
 
     NetConnectionsUpdate Update();
 
@@ -170,4 +587,10 @@ private:
     boost::container::flat_map<NetAddr, NetConnection> m_connections;
     boost::asio::ip::udp::socket m_socket;
     std::vector<NetAddr> m_newConnections;
+    CongestionControllerFactory m_congestionControllerFactory;
+    SendSchedulerConfig m_schedulerConfig;
+    size_t m_parityGroupSize = 0;
+    std::shared_ptr<NetPacketCompressor> m_compressor;
+    std::function<void(NetData const&)> m_sentPacketObserver;
+    NetData m_recvBuffer;
 };
\ No newline at end of file
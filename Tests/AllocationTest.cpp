@@ -0,0 +1,167 @@
+#include "QuickGameNetworking/NetAPI.h"
+#include "QuickGameNetworking/NetMessages.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Steady-state SendMessage and BroadcastMessage must not touch the heap once the buffer pool is
+// warmed up, and neither may receiving a message: packets are parsed into buffers recycled by the
+// connection and message containers are recycled by the factory.
+// Building and sending datagrams in Update is not covered.
+
+namespace
+{
+    size_t g_allocations = 0;
+
+    size_t constexpr WARM_UP_ITERATIONS = 1000;
+    size_t constexpr ITERATIONS = 1000;
+
+    class AllocationTestMessage : public SingletonNetMessageBase
+    {
+        DEFINE_NET_MESSAGE(AllocationTestMessage);
+
+    public:
+        std::string text = std::string(40, 'x');
+        std::vector<uint32_t> values = std::vector<uint32_t>(8, 7);
+
+    private:
+        friend class boost::serialization::access;
+        template<class Archive>
+        void serialize(Archive& ar, const unsigned int)
+        {
+            ar & text;
+            ar & values;
+        }
+    };
+
+    // Only the allocations made by measured() count, update() runs between calls
+    template<typename Measured, typename Update>
+    size_t CountAllocations(Measured const& measured, Update const& update)
+    {
+        size_t allocations = 0;
+        for (size_t i = 0; i < WARM_UP_ITERATIONS + ITERATIONS; ++i)
+        {
+            size_t const start = g_allocations;
+            measured();
+            if (i >= WARM_UP_ITERATIONS)
+            {
+                allocations += g_allocations - start;
+            }
+            update();
+        }
+        return allocations;
+    }
+
+    bool Check(char const* name, size_t const allocations)
+    {
+        std::cout << name << ": " << static_cast<double>(allocations) / ITERATIONS << " allocations per call\n";
+        return allocations == 0;
+    }
+
+    // Receives and drops everything, acking whatever the API sends reliably
+    void Drain(NetSocket& socket)
+    {
+        socket.Update();
+        while (socket.RecvMessage())
+        {
+        }
+    }
+}
+
+void* operator new(size_t size)
+{
+    g_allocations++;
+    if (void* memory = std::malloc(size > 0 ? size : 1))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+int main()
+{
+    // port 0 everywhere, the actual ports are read back once bound
+    NetAddr const loopback(boost::asio::ip::address::from_string("127.0.0.1"), 0);
+    NetObjectAPI::Init(loopback, true);
+    NetObjectAPI* api = NetObjectAPI::GetInstance();
+    NetAddr const host = api->GetLocalAddress();
+    NetDataFactory::GetInstance()->RegisterDataContainer<AllocationTestMessage>();
+
+    // Bare sockets play the peers. They must answer, or the API keeps resending its reliable
+    // session setup to them.
+    boost::asio::io_service ioService;
+    std::vector<NetSocket> peers;
+    std::vector<NetAddr> recipients;
+    peers.reserve(4);
+    for (size_t i = 0; i < 4; ++i)
+    {
+        peers.emplace_back(ioService, loopback);
+        recipients.push_back(peers.back().GetLocalAddress());
+    }
+
+    AllocationTestMessage const message;
+    auto const drainPeers = [&]
+    {
+        for (NetSocket& peer : peers)
+        {
+            Drain(peer);
+        }
+    };
+    auto const update = [&]
+    {
+        api->Update();
+        drainPeers();
+    };
+    bool passed = true;
+    passed &= Check("SendMessage", CountAllocations([&]
+    {
+        api->SendMessage(message, recipients.front(), ESendOptions::None);
+    }, update));
+    passed &= Check("4-way BroadcastMessage", CountAllocations([&]
+    {
+        api->BroadcastMessage(message, recipients, ESendOptions::None);
+    }, update));
+
+    // The first peer sends, so each update of the API receives, parses, deserializes and handles
+    // one datagram. Messages to the API's own address would skip the socket altogether.
+    NetSocket& peer = peers.front();
+    NetData payload;
+    NetBitWriter writer(payload);
+    // not using session type indices
+    writer.WriteBool(false);
+    writer << NetTypeID(message.GetTypeID());
+    static_cast<INetData const&>(message).Serialize(writer);
+    writer.Flush();
+    NetSharedData const sharedPayload = std::make_shared<NetData const>(payload);
+
+    size_t received = 0;
+    api->RegisterMessageHandler<AllocationTestMessage>([&received](AllocationTestMessage const&, NetAddr const&)
+    {
+        received++;
+    });
+    passed &= Check("Receive", CountAllocations([api] { api->Update(); }, [&]
+    {
+        peer.SendMessage(sharedPayload, host, ESendOptions::None);
+        drainPeers();
+    }));
+    // the first update runs before anything was sent
+    if (received + 1 < WARM_UP_ITERATIONS + ITERATIONS)
+    {
+        std::cout << "received " << received << " of " << WARM_UP_ITERATIONS + ITERATIONS << " messages\n";
+        passed = false;
+    }
+
+    NetObjectAPI::Shutdown();
+    return passed ? 0 : 1;
+}
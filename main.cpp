@@ -56,9 +56,22 @@ public:
     float scale;
     float rot;
 
-private:
-    virtual void Serialize(boost::archive::binary_oarchive& stream) const override { stream << x << y << dx << dy << scale << rot; }
-    virtual void Deserialize(boost::archive::binary_iarchive& stream) override { stream >> x >> y >> dx >> dy >> scale >> rot; }
+    // Positions stay well inside [-64, 64]: 16 bits, error under 0.001
+    using PositionCodec = NetQuantizedFloatCodec<NetFloatRange<-64, 64, 16>>;
+    // Velocities are set within [-0.01, 0.01]: 12 bits, error under 2.5e-6 per frame of extrapolation
+    using VelocityCodec = NetQuantizedFloatCodec<NetFloatRange<-1, 1, 12, 100>>;
+    // Scale is set within [0.04, 0.06]: 8 bits, error under 0.00004
+    using ScaleCodec = NetQuantizedFloatCodec<NetFloatRange<4, 6, 8, 100>>;
+
+    // rot is an orientation and only matters modulo 2pi: 10 bits, error under 0.0031 radians.
+    // The host writes through SetField so updates only carry the fields that changed.
+    DEFINE_NET_TRACKED_FIELDS(
+        NetField<&ObjectSyncMemento::x, PositionCodec>,
+        NetField<&ObjectSyncMemento::y, PositionCodec>,
+        NetField<&ObjectSyncMemento::dx, VelocityCodec>,
+        NetField<&ObjectSyncMemento::dy, VelocityCodec>,
+        NetField<&ObjectSyncMemento::scale, ScaleCodec>,
+        NetField<&ObjectSyncMemento::rot, NetAngleCodec<10>>);
 };
 
 void server_main()
@@ -111,10 +124,7 @@ int main()
 
     boost::asio::ip::udp::endpoint hostAddress(boost::asio::ip::address::from_string("127.0.0.1"), HOST_PORT);
     NetObjectAPI::Init(hostAddress, isHost);
-    NetDataFactory::GetInstance()->RegisterDataContainer<ControllerDescriptor>();
-    NetDataFactory::GetInstance()->RegisterDataContainer<ObjectDescriptor>();
-    NetDataFactory::GetInstance()->RegisterDataContainer<ObjectCreationMessage>();
-    NetDataFactory::GetInstance()->RegisterDataContainer<ObjectSyncMemento>();
+    NetDataFactory::GetInstance()->RegisterDataContainers(NetTypeList<ControllerDescriptor, ObjectDescriptor, ObjectCreationMessage, ObjectSyncMemento>());
     auto masterNetObj = NetObjectAPI::GetInstance()->CreateThirdPartyNetObject(NetObjectDescriptor::Create<ControllerDescriptor>());
     std::vector<std::size_t> ids;
     std::vector<std::unique_ptr<NetObject>> objects;
@@ -138,14 +148,14 @@ int main()
             {
                 ObjectCreationMessage msg;
                 msg.id = id;
-                masterNetObj->SendMasterUnicast(msg, addr, ESendOptions::Reliable);
+                masterNetObj->SendMasterUnicast(msg, addr, ESendOptions::Reliable | ESendOptions::Unordered);
             }
         });
         while (ids.size() < 100)
         {
             ObjectCreationMessage msg;
             msg.id = objects.size();
-            masterNetObj->SendMasterBroadcast(msg, ESendOptions::Reliable);
+            masterNetObj->SendMasterBroadcast(msg, ESendOptions::Reliable | ESendOptions::Unordered);
             createObject(msg.id);
             ids.emplace_back(msg.id);
         }
@@ -292,18 +302,18 @@ int main()
         {
             if (isHost && (RandomFloat(0, 1) > 0.95f))
             {
-                obj->dx = 0.01f * RandomFloat(-1, 1);
-                obj->dy = 0.01f * RandomFloat(-1, 1);
-                obj->rot += 0.02f * RandomFloat(-1, 1);
-                obj->scale = 0.05f + 0.01f * RandomFloat(-1, 1);
+                obj->SetField<&ObjectSyncMemento::dx>(0.01f * RandomFloat(-1, 1));
+                obj->SetField<&ObjectSyncMemento::dy>(0.01f * RandomFloat(-1, 1));
+                obj->SetField<&ObjectSyncMemento::rot>(obj->rot + 0.02f * RandomFloat(-1, 1));
+                obj->SetField<&ObjectSyncMemento::scale>(0.05f + 0.01f * RandomFloat(-1, 1));
             }
-            obj->x += obj->dx;
-            obj->y += obj->dy;
+            obj->SetField<&ObjectSyncMemento::x>(obj->x + obj->dx);
+            obj->SetField<&ObjectSyncMemento::y>(obj->y + obj->dy);
             // create transformations
             glm::mat4 transform = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
             transform = glm::scale(transform, glm::vec3(obj->scale, obj->scale, obj->scale));
             transform = glm::translate(transform, glm::vec3(obj->x, obj->y, 0.0f));
-            transform = glm::rotate(transform, (float)glfwGetTime(), glm::vec3(0.0f, 0.0f, obj->rot));
+            transform = glm::rotate(transform, (float)glfwGetTime() + obj->rot, glm::vec3(0.0f, 0.0f, 1.0f));
 
             // get matrix's uniform location and set matrix
             GLint transformLoc = glGetUniformLocation(shaderProgram, "transform");